@@ -4,9 +4,17 @@
 
 #include "ArduinoVariant.h"
 
+#include <algorithm>
+
 ArduinoVariant::ArduinoVariant(const char* other)
     : value(String(other)) {}
 
+ArduinoVariant::ArduinoVariant(const Int16Array& other)
+    : value(other) {}
+
+ArduinoVariant::ArduinoVariant(const FloatArray& other)
+    : value(other) {}
+
 size_t ArduinoVariant::printTo(Print& printer) const {
     return printer.print(as<String>());
 }
@@ -21,11 +29,48 @@ void ArduinoVariant::clear() {
             v = 0;
         } else if constexpr (std::is_same_v<T, String>) {
             v = "";
+        } else if constexpr (isArrayType<T>) {
+            std::fill(v.begin(), v.end(), 0);
         }
     },
                value);
 }
 
+size_t ArduinoVariant::toChars(char* buffer, size_t size) const {
+    if (!size) return 0;
+
+    int written = std::visit([&](auto&& v) -> int {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, String>)
+            return snprintf(buffer, size, "%s", v.c_str());
+        else if constexpr (std::is_same_v<T, bool>)
+            return snprintf(buffer, size, "%s", v ? "true" : "false");
+        else if constexpr (isArrayType<T>)
+            return snprintf(buffer, size, "[%u values]", (unsigned)v.size());
+        else if constexpr (std::is_floating_point_v<T>)
+            return snprintf(buffer, size, "%g", (double)v);
+        else if constexpr (std::is_signed_v<T>)
+            return snprintf(buffer, size, "%lld", (long long)v);
+        else if constexpr (std::is_unsigned_v<T>)
+            return snprintf(buffer, size, "%llu", (unsigned long long)v);
+        else {
+            buffer[0] = '\0';
+            return 0;
+        }
+    },
+                             value);
+
+    return written < 0 ? 0 : std::min((size_t)written, size - 1);
+}
+
+bool ArduinoVariant::operator==(const ArduinoVariant& other) const {
+    return value == other.value;
+}
+
+bool ArduinoVariant::operator!=(const ArduinoVariant& other) const {
+    return !(*this == other);
+}
+
 bool ArduinoVariant::isValid() const {
     return !std::holds_alternative<std::monostate>(value);
 }
@@ -34,21 +79,41 @@ bool ArduinoVariant::isInvalid() const {
     return std::holds_alternative<std::monostate>(value);
 }
 
+bool ArduinoVariant::isArray() const {
+    return std::holds_alternative<Int16Array>(value) || std::holds_alternative<FloatArray>(value);
+}
+
+size_t ArduinoVariant::size() const {
+    return std::visit([](auto&& v) -> size_t {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (isArrayType<T>)
+            return v.size();
+        else
+            return 0;
+    },
+                      value);
+}
+
 void ArduinoVariant::load(const char* key, Preferences& prefs) {
     std::visit([&](auto&& val) {
         using T = std::decay_t<decltype(val)>;
         if constexpr (std::is_same_v<T, String>) val = prefs.getString(key, val);
-            else if constexpr (std::is_same_v<T, bool>) prefs.getBool(key, val);
-            else if constexpr (std::is_same_v<T, double>) prefs.getDouble(key, val);
-            else if constexpr (std::is_same_v<T, float>) prefs.getFloat(key, val);
-            else if constexpr (std::is_same_v<T, int8_t>) prefs.getChar(key, val);
-            else if constexpr (std::is_same_v<T, uint8_t>) prefs.getUChar(key, val);
-            else if constexpr (std::is_same_v<T, int16_t>) prefs.getShort(key, val);
-            else if constexpr (std::is_same_v<T, uint16_t>) prefs.getUShort(key, val);
-            else if constexpr (std::is_same_v<T, int32_t>) prefs.getInt(key, val);
-            else if constexpr (std::is_same_v<T, uint32_t>) prefs.getUInt(key, val);
-            else if constexpr (std::is_same_v<T, int64_t>) prefs.getLong64(key, val);
-            else if constexpr (std::is_same_v<T, uint64_t>) prefs.getULong64(key, val);
+            else if constexpr (std::is_same_v<T, bool>) val = prefs.getBool(key, val);
+            else if constexpr (std::is_same_v<T, double>) val = prefs.getDouble(key, val);
+            else if constexpr (std::is_same_v<T, float>) val = prefs.getFloat(key, val);
+            else if constexpr (std::is_same_v<T, int8_t>) val = prefs.getChar(key, val);
+            else if constexpr (std::is_same_v<T, uint8_t>) val = prefs.getUChar(key, val);
+            else if constexpr (std::is_same_v<T, int16_t>) val = prefs.getShort(key, val);
+            else if constexpr (std::is_same_v<T, uint16_t>) val = prefs.getUShort(key, val);
+            else if constexpr (std::is_same_v<T, int> || std::is_same_v<T, int32_t>) val = prefs.getInt(key, val);
+            else if constexpr (std::is_same_v<T, uint32_t>) val = prefs.getUInt(key, val);
+            else if constexpr (std::is_same_v<T, int64_t>) val = prefs.getLong64(key, val);
+            else if constexpr (std::is_same_v<T, uint64_t>) val = prefs.getULong64(key, val);
+            else if constexpr (isArrayType<T>) {
+                // arrays keep their length, a blob of a different size is ignored
+                size_t bytes = val.size() * sizeof(typename T::value_type);
+                if (prefs.getBytesLength(key) == bytes) prefs.getBytes(key, val.data(), bytes);
+            }
     }, value);
 }
 
@@ -63,10 +128,29 @@ void ArduinoVariant::save(const char* key, Preferences& prefs) const {
             else if constexpr (std::is_same_v<T, uint8_t>) prefs.putUChar(key, val);
             else if constexpr (std::is_same_v<T, int16_t>) prefs.putShort(key, val);
             else if constexpr (std::is_same_v<T, uint16_t>) prefs.putUShort(key, val);
-            else if constexpr (std::is_same_v<T, int32_t>) prefs.putInt(key, val);
+            else if constexpr (std::is_same_v<T, int> || std::is_same_v<T, int32_t>) prefs.putInt(key, val);
             else if constexpr (std::is_same_v<T, uint32_t>) prefs.putUInt(key, val);
             else if constexpr (std::is_same_v<T, int64_t>) prefs.putLong64(key, val);
             else if constexpr (std::is_same_v<T, uint64_t>) prefs.putULong64(key, val);
+            else if constexpr (isArrayType<T>) prefs.putBytes(key, val.data(), val.size() * sizeof(typename T::value_type));
+        }, value);
+}
+
+void ArduinoVariant::save(const char* key, nvs_handle_t handle) const {
+        std::visit([&](auto&& val) {
+            using T = std::decay_t<decltype(val)>;
+            if constexpr (std::is_same_v<T, String>) nvs_set_str(handle, key, val.c_str());
+            else if constexpr (std::is_same_v<T, bool>) nvs_set_u8(handle, key, val ? 1 : 0);
+            else if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) nvs_set_blob(handle, key, &val, sizeof(T));
+            else if constexpr (std::is_same_v<T, int8_t>) nvs_set_i8(handle, key, val);
+            else if constexpr (std::is_same_v<T, uint8_t>) nvs_set_u8(handle, key, val);
+            else if constexpr (std::is_same_v<T, int16_t>) nvs_set_i16(handle, key, val);
+            else if constexpr (std::is_same_v<T, uint16_t>) nvs_set_u16(handle, key, val);
+            else if constexpr (std::is_same_v<T, int> || std::is_same_v<T, int32_t>) nvs_set_i32(handle, key, val);
+            else if constexpr (std::is_same_v<T, uint32_t>) nvs_set_u32(handle, key, val);
+            else if constexpr (std::is_same_v<T, int64_t>) nvs_set_i64(handle, key, val);
+            else if constexpr (std::is_same_v<T, uint64_t>) nvs_set_u64(handle, key, val);
+            else if constexpr (isArrayType<T>) nvs_set_blob(handle, key, val.data(), val.size() * sizeof(typename T::value_type));
         }, value);
 }
 
@@ -8,14 +8,24 @@
 #include <Print.h>
 #include <Printable.h>
 #include <WString.h>
+#include <nvs.h>
 #include <stdint.h>
 
 #include <variant>
+#include <vector>
 
 class ArduinoVariant : public Printable {
   public:
-    using VariantType = std::variant<std::monostate, int, float, double, bool, String, int8_t, uint8_t, int16_t, uint16_t, int32_t, uint32_t, int64_t, uint64_t>;
+    // arrays are stored as contiguous buffers, data<T>() exposes them for bulk processing
+    using Int16Array = std::vector<int16_t>;
+    using FloatArray = std::vector<float>;
+
+    using VariantType = std::variant<std::monostate, int, float, double, bool, String, int8_t, uint8_t, int16_t, uint16_t, int32_t, uint32_t, int64_t, uint64_t, Int16Array, FloatArray>;
     using VariantTuple = std::tuple<int, float, double, bool, String, int8_t, uint8_t, int16_t, uint16_t, int32_t, uint32_t, int64_t, uint64_t>;
+    using ArrayTuple   = std::tuple<int16_t, float>;
+
+    template <typename T>
+    static constexpr bool isArrayType = std::is_same_v<T, Int16Array> || std::is_same_v<T, FloatArray>;
 
   protected:
     VariantType value = {};
@@ -27,12 +37,22 @@ class ArduinoVariant : public Printable {
     ArduinoVariant(T other);
 
     ArduinoVariant(const char* other);
+    ArduinoVariant(const Int16Array& other);
+    ArduinoVariant(const FloatArray& other);
 
     template <typename T>
     bool is() const;
 
     bool isValid() const;
     bool isInvalid() const;
+    bool isArray() const;
+
+    // element access for array values, nullptr if the value is not an array of T
+    template <typename T>
+    T* data();
+    template <typename T>
+    const T* data() const;
+    size_t size() const;
 
     template <typename T, typename = std::enable_if_t<std::disjunction_v<std::is_same<T, std::monostate>, std::is_arithmetic<T>, std::is_same<T, String> > > >
     ArduinoVariant& operator=(T other);
@@ -43,10 +63,18 @@ class ArduinoVariant : public Printable {
     template <typename T>
     T as() const;
 
+    bool operator==(const ArduinoVariant& other) const;
+    bool operator!=(const ArduinoVariant& other) const;
+
     void clear();
 
+    // formats the value into buffer without allocating, arrays are summarized by their length
+    size_t toChars(char* buffer, size_t size) const;
+
     void load(const char* key, Preferences& pref);
     void save(const char* key, Preferences& pref) const;
+    // same layout as the Preferences overload, but leaves the nvs_commit() to the caller
+    void save(const char* key, nvs_handle_t handle) const;
 
   protected:
     size_t printTo(Print& printer) const;
@@ -61,6 +89,18 @@ bool ArduinoVariant::is() const {
     return std::holds_alternative<T>(value);
 }
 
+template <typename T>
+T* ArduinoVariant::data() {
+    auto array = std::get_if<std::vector<T>>(&value);
+    return array ? array->data() : nullptr;
+}
+
+template <typename T>
+const T* ArduinoVariant::data() const {
+    auto array = std::get_if<std::vector<T>>(&value);
+    return array ? array->data() : nullptr;
+}
+
 template <typename T, typename>
 ArduinoVariant& ArduinoVariant::operator=(T other) {
     value = other;
@@ -86,6 +126,19 @@ T ArduinoVariant::as() const {
             } else {
                 return T{};
             }
+        } else if constexpr (isArrayType<Type> || isArrayType<T>) {
+            if constexpr (std::is_same_v<T, Type>) {
+                return v;
+            } else if constexpr (std::is_same_v<T, String>) {
+                String result;
+                for (size_t i = 0; i < v.size(); i++) {
+                    if (i) result += ",";
+                    result += String(v[i]);
+                }
+                return result;
+            } else {
+                return T{};
+            }
         } else if constexpr (std::is_same_v<Type, bool>) {
             if constexpr (std::is_arithmetic_v<T>) {
                 return static_cast<T>(v);
@@ -0,0 +1,140 @@
+#if (__cplusplus < 201703L)
+#error "This library requires C++17 / Espressif32 Arduino 3.x"
+#else
+
+#include "AuditLog.h"
+
+#include <Arduino.h>
+#include <time.h>
+
+void AuditLog::record(uint32_t clientIP, const String& key, Source source, const char* oldValue, const char* newValue) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    Entry& entry = entries[count % RESTAPI_AUDIT_SIZE];
+
+    entry.format   = Format;
+    entry.source   = source;
+    entry.sequence = count++;
+    entry.uptime   = millis();
+    entry.time     = ::time(nullptr);
+    entry.clientIP = clientIP;
+    strlcpy(entry.key, key.c_str(), sizeof(entry.key));
+    strlcpy(entry.oldValue, oldValue, sizeof(entry.oldValue));
+    strlcpy(entry.newValue, newValue, sizeof(entry.newValue));
+
+    lock.unlock();
+
+    // the flash write happens on the flush task, never on the mutation path
+    if (flushTask) xTaskNotifyGive(flushTask);
+}
+
+bool AuditLog::at(size_t age, Entry& entry) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (age >= count || age >= RESTAPI_AUDIT_SIZE) return false;
+
+    uint32_t sequence = count - 1 - age;
+    entry             = entries[sequence % RESTAPI_AUDIT_SIZE];
+
+    // slots that were not restored from flash still hold a different sequence
+    return entry.sequence == sequence;
+}
+
+uint32_t AuditLog::total() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
+}
+
+bool AuditLog::mirrorTo(fs::FS& fs, const char* path, size_t pageSize) {
+    if (filesystem) return false;
+
+    this->filesystem = &fs;
+    this->path       = path;
+    this->pageSize   = pageSize;
+
+    restore(pagePath(1));
+    restore(pagePath(0));
+
+    page = fs.open(pagePath(0), FILE_APPEND);
+    if (!page) return false;
+
+    return xTaskCreate(flushTaskMain, "restapi_audit", RESTAPI_AUDIT_FLUSH_STACK_SIZE, this, 1, &flushTask) == pdPASS;
+}
+
+const char* AuditLog::sourceName(Source source) {
+    switch (source) {
+        case Source::Form: return "form";
+        case Source::Patch: return "patch";
+        case Source::Delete: return "delete";
+        case Source::Import: return "import";
+    }
+    return "unknown";
+}
+
+String AuditLog::pagePath(uint8_t number) const {
+    return path + "." + String(number);
+}
+
+void AuditLog::restore(const String& filename) {
+    if (!filesystem->exists(filename)) return;
+
+    fs::File file = filesystem->open(filename, FILE_READ);
+    if (!file) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Entry entry;
+    while (file.read((uint8_t*)&entry, sizeof(Entry)) == sizeof(Entry)) {
+        if (entry.format != Format) return;
+        entry.key[sizeof(entry.key) - 1]           = '\0';
+        entry.oldValue[sizeof(entry.oldValue) - 1] = '\0';
+        entry.newValue[sizeof(entry.newValue) - 1] = '\0';
+
+        entries[entry.sequence % RESTAPI_AUDIT_SIZE] = entry;
+        count                                        = entry.sequence + 1;
+        flushed                                      = count;
+    }
+}
+
+// Writes the entries recorded since the last call, entries that were overwritten in the meantime are skipped
+void AuditLog::flush() {
+    Entry entry;
+
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (flushed == count) return;
+            if (count - flushed > RESTAPI_AUDIT_SIZE) flushed = count - RESTAPI_AUDIT_SIZE;
+            entry = entries[flushed % RESTAPI_AUDIT_SIZE];
+            flushed++;
+        }
+        write(entry);
+    }
+}
+
+void AuditLog::write(const Entry& entry) {
+    if (!page) return;
+
+    // the current page is full: it replaces the previous page and a new one is started
+    if (page.size() + sizeof(Entry) > pageSize) {
+        page.close();
+        if (filesystem->exists(pagePath(1))) filesystem->remove(pagePath(1));
+        filesystem->rename(pagePath(0), pagePath(1));
+        page = filesystem->open(pagePath(0), FILE_APPEND);
+        if (!page) return;
+    }
+
+    page.write((const uint8_t*)&entry, sizeof(Entry));
+    page.flush();
+}
+
+void AuditLog::flushTaskMain(void* arg) {
+    auto log = static_cast<AuditLog*>(arg);
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        log->flush();
+    }
+}
+
+#endif
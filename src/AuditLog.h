@@ -0,0 +1,86 @@
+#pragma once
+
+#if (__cplusplus < 201703L)
+#error "This library requires C++17 / Espressif32 Arduino 3.x"
+#else
+
+#include <FS.h>
+#include <WString.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdint.h>
+
+#include <mutex>
+
+#ifndef RESTAPI_AUDIT_SIZE
+#define RESTAPI_AUDIT_SIZE 32
+#endif
+
+#ifndef RESTAPI_AUDIT_KEY_SIZE
+#define RESTAPI_AUDIT_KEY_SIZE 24
+#endif
+
+#ifndef RESTAPI_AUDIT_VALUE_SIZE
+#define RESTAPI_AUDIT_VALUE_SIZE 24
+#endif
+
+#ifndef RESTAPI_AUDIT_FLUSH_STACK_SIZE
+#define RESTAPI_AUDIT_FLUSH_STACK_SIZE 4096
+#endif
+
+// Fixed-size ring buffer of parameter changes. Recording only copies into RAM and never allocates, the oldest entry
+// is overwritten once RESTAPI_AUDIT_SIZE entries are stored. Entries can optionally be mirrored to two alternating
+// files ("pages") on a filesystem by a background task, they are read back by mirrorTo() after a reboot.
+class AuditLog {
+  public:
+    enum class Source : uint8_t { Form, Patch, Delete, Import };
+
+    // stored by key name, so entries restored from flash stay correct when the parameters of the firmware change
+    struct Entry {
+        uint16_t format   = Format;
+        Source   source   = Source::Patch;
+        uint32_t sequence = 0;
+        uint32_t uptime   = 0;
+        uint32_t time     = 0;
+        uint32_t clientIP = 0;
+        char     key[RESTAPI_AUDIT_KEY_SIZE]        = {};
+        char     oldValue[RESTAPI_AUDIT_VALUE_SIZE] = {};
+        char     newValue[RESTAPI_AUDIT_VALUE_SIZE] = {};
+    };
+
+    // written into every entry, pages of a different entry layout are ignored on restore
+    static const uint16_t Format = 0xA102;
+
+  public:
+    void record(uint32_t clientIP, const String& key, Source source, const char* oldValue, const char* newValue);
+
+    // copies the entry of the given age (0 is the newest), false once age reaches the number of stored entries
+    bool     at(size_t age, Entry& entry) const;
+    uint32_t total() const;
+
+    bool mirrorTo(fs::FS& fs, const char* path, size_t pageSize);
+
+    static const char* sourceName(Source source);
+
+  protected:
+    Entry    entries[RESTAPI_AUDIT_SIZE] = {};
+    uint32_t count                       = 0;
+    uint32_t flushed                     = 0;
+
+    mutable std::mutex mutex;
+
+    fs::FS*      filesystem = nullptr;
+    String       path       = "";
+    size_t       pageSize   = 0;
+    fs::File     page;
+    TaskHandle_t flushTask = nullptr;
+
+  protected:
+    String      pagePath(uint8_t number) const;
+    void        restore(const String& filename);
+    void        flush();
+    void        write(const Entry& entry);
+    static void flushTaskMain(void* arg);
+};
+
+#endif
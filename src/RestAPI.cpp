@@ -6,15 +6,28 @@
 
 #include <ArduinoJson.h>
 #include <AsyncJson.h>
+#include <lwip/priv/tcp_priv.h>
+#include <lwip/tcpip.h>
 
+#include <limits>
+#include <memory>
 #include <variant>
+
+#ifndef RESTAPI_MAX_BODY_SIZE
+#define RESTAPI_MAX_BODY_SIZE 16384
+#endif
+
 static AsyncResponseStream* beginJsonResponse(AsyncWebServerRequest* request);
-static std::vector<String>  splitPath(const String& basePath, AsyncWebServerRequest* req, const char* delimiter = "/");
-static void                 value2json(ArduinoVariant& value, JsonVariant&& json);
-static void                 doc2value(const String& key, JsonDocument& doc, ArduinoVariant& value);
-static void                 value2doc(const String& key, JsonDocument& doc, ArduinoVariant& value);
-static void                 NullHandler(AsyncWebServerRequest* request);
-static RestParameter*       findParameter(std::vector<RestParameter*>& parameters, const String& name);
+static std::vector<String>  splitPath(const String& basePath, const String& url, const char* delimiter = "/");
+static void                 value2json(const ArduinoVariant& value, JsonVariant&& json);
+static void                 json2value(JsonVariantConst json, ArduinoVariant& value);
+static void                 value2doc(const String& key, JsonDocument& doc, const ArduinoVariant& value);
+static void                 BodyHandler(AsyncWebServerRequest* req, uint8_t* data, size_t len, size_t offset, size_t total);
+static DeserializationError deserializeBody(const RestAPI::Context& context, JsonDocument& doc);
+static RestParameter*       findParameter(std::vector<RestParameter*>& parameters, const String& name, uint16_t* index = nullptr);
+static void                 formatAuditValue(const RestParameter& parameter, char* buffer, size_t size);
+static bool                 validateValue(RestParameter& parameter, JsonVariantConst json, String& error);
+static bool                 validateArray(RestParameter& parameter, JsonVariantConst json, String& error);
 
 RestAPI::RestAPI(AsyncWebServer* server)
     : server(server) {}
@@ -24,11 +37,15 @@ RestAPI::RestAPI(AsyncWebServer& server)
 
 void RestAPI::begin(const String& baseRoute, const String& pageTitle, const String& buttonText) {
     if (!server) return;
-    this->baseRoute  = baseRoute;
-    this->formRoute  = baseRoute + "/form";
-    this->apiRoute   = baseRoute + "/api";
-    this->pageTitle  = pageTitle;
-    this->buttonText = buttonText;
+    this->baseRoute    = baseRoute;
+    this->formRoute    = baseRoute + "/form";
+    this->apiRoute     = baseRoute + "/api";
+    this->metricsRoute = apiRoute + "/_metrics";
+    this->exportRoute  = apiRoute + "/_export";
+    this->importRoute  = apiRoute + "/_import";
+    this->auditRoute   = apiRoute + "/_audit";
+    this->pageTitle    = pageTitle;
+    this->buttonText   = buttonText;
     setupRoutes();
 }
 
@@ -42,175 +59,682 @@ void RestAPI::addParameter(RestParameter* parameter) {
 
 void RestAPI::onParameterChange(ParameterChangeHandler handler) { parameterChangeHandler = handler; }
 
+void RestAPI::onParametersChange(ParametersChangeHandler handler) { parametersChangeHandler = handler; }
+
+bool RestAPI::mirrorAuditLog(fs::FS& fs, const char* path, size_t pageSize) {
+    return auditLog.mirrorTo(fs, path, pageSize);
+}
+
+void RestAPI::setExecutionMode(Route route, ExecutionMode mode) {
+    if (route < Route::Count) executionModes[(size_t)route] = mode;
+}
+
+// Either all count workers are running or none is, a failed start deletes the tasks created so far
+bool RestAPI::beginWorkers(uint8_t count, int core) {
+    if (workersRunning || !count) return false;
+
+    workQueue = xQueueCreate(RESTAPI_WORKER_QUEUE_LENGTH, sizeof(std::shared_ptr<Job>*));
+    if (!workQueue) return false;
+
+    std::vector<TaskHandle_t> tasks;
+    for (uint8_t i = 0; i < count; i++) {
+        TaskHandle_t task = nullptr;
+        if (xTaskCreatePinnedToCore(workerTask, "restapi_worker", RESTAPI_WORKER_STACK_SIZE, this, RESTAPI_WORKER_PRIORITY, &task, core) != pdPASS) {
+            // nothing has been queued yet, the tasks are all blocked in xQueueReceive
+            for (auto created : tasks) vTaskDelete(created);
+            vQueueDelete(workQueue);
+            workQueue = nullptr;
+            return false;
+        }
+        tasks.push_back(task);
+    }
+
+    workersRunning = true;
+    return true;
+}
+
+RestAPI::Context::Context(AsyncWebServerRequest* request)
+    : url(request->url()), clientIP((uint32_t)request->client()->remoteIP()), contentLength(request->contentLength()), body((char*)request->_tempObject) {
+    // the context owns the body from now on, the request would free it on disconnect
+    request->_tempObject = nullptr;
+
+    for (size_t i = 0; i < request->params(); i++) {
+        auto param = request->getParam(i);
+        if (!param->isPost() && !param->isFile()) query.emplace_back(param->name(), param->value());
+    }
+}
+
+RestAPI::Context::~Context() {
+    free(body);
+}
+
+bool RestAPI::Context::hasParam(const char* name) const {
+    for (auto& param : query)
+        if (param.first == name) return true;
+    return false;
+}
+
+String RestAPI::Context::param(const char* name) const {
+    for (auto& param : query)
+        if (param.first == name) return param.second;
+    return "";
+}
+
+// Sends the output of a job. The response stays in its setup state while the worker runs the handler and is
+// started by the AsyncTCP poll once the job is done, so only the AsyncTCP task touches the request and its socket.
+// A client that disconnects in the meantime deletes the response, the job is kept alive by the worker's reference.
+class RestAPI::JobResponse : public AsyncAbstractResponse {
+  public:
+    JobResponse(std::shared_ptr<Job> job)
+        : job(job) {}
+
+    bool _sourceValid() const override { return true; }
+
+    void _respond(AsyncWebServerRequest* request) override {
+        if (job->done) start(request);
+    }
+
+    size_t _ack(AsyncWebServerRequest* request, size_t len, uint32_t time) override {
+        if (_state != RESPONSE_SETUP) return AsyncAbstractResponse::_ack(request, len, time);
+        if (job->done) start(request);
+        return 0;
+    }
+
+  protected:
+    std::shared_ptr<Job> job;
+    size_t               sent = 0;
+
+    void start(AsyncWebServerRequest* request) {
+        setCode(job->context.code);
+        setContentType(job->context.contentType);
+        setContentLength(job->context.output.length());
+        AsyncAbstractResponse::_respond(request);
+    }
+
+    size_t _fillBuffer(uint8_t* data, size_t len) override {
+        const String& output = job->context.output;
+
+        size_t length = std::min(len, output.length() - sent);
+        memcpy(data, output.c_str() + sent, length);
+        sent += length;
+        return length;
+    }
+};
+
+// Runs the handler inline on the AsyncTCP task or hands a copy of the request to the worker pool.
+// Either way the handler only sees the Context, the response is always sent from the AsyncTCP task.
+// While workers are running an inline handler never waits for a lock: if a worker holds it, the handler
+// gives up before changing anything and the request is handed to the pool instead.
+ArRequestHandlerFunction RestAPI::dispatch(Route route, Handler handler) {
+    return [this, route, handler](AsyncWebServerRequest* req) {
+        auto job = std::make_shared<Job>(req, handler);
+
+        if (executionModes[(size_t)route] == ExecutionMode::Inline || !workersRunning) {
+            job->context.deferrable = workersRunning;
+            (this->*handler)(job->context);
+            if (!job->context.deferred) {
+                req->send(job->context.code, job->context.contentType, job->context.output);
+                return;
+            }
+            job->context.deferrable = false;
+        }
+
+        // the AsyncTCP task is the only producer, so a free slot cannot disappear before xQueueSend
+        if (!uxQueueSpacesAvailable(workQueue)) {
+            rejectedJobs++;
+            req->send(503, "application/json", "{\"error\":\"busy\"}");
+            return;
+        }
+
+        job->pcb    = req->client()->pcb();
+        job->client = req->client();
+
+        auto queued = new std::shared_ptr<Job>(job);
+        xQueueSend(workQueue, &queued, 0);
+        req->send(new JobResponse(job));
+    };
+}
+
+// Takes the lock for the handler. Only an inline handler running next to workers may give up, it marks the
+// context as deferred and must return without side effects.
+bool RestAPI::acquire(Context& context, std::unique_lock<std::mutex>& lock) {
+    if (!context.deferrable) {
+        lock.lock();
+        return true;
+    }
+    if (lock.try_lock()) return true;
+    context.deferred = true;
+    return false;
+}
+
+// Runs in the lwIP thread. Invokes the poll callback of the job's connection, so the AsyncTCP task starts the
+// JobResponse right away instead of on the next regular poll, which lwIP only triggers every 500 ms. The pcb is
+// only used if it is still active and still belongs to the same client, a closed connection is skipped.
+static void wakeConnection(void* arg) {
+    auto wake = static_cast<std::pair<tcp_pcb*, void*>*>(arg);
+
+    for (tcp_pcb* pcb = tcp_active_pcbs; pcb; pcb = pcb->next) {
+        if (pcb != wake->first) continue;
+        if (pcb->callback_arg == wake->second && pcb->poll) pcb->poll(pcb->callback_arg, pcb);
+        break;
+    }
+
+    delete wake;
+}
+
+void RestAPI::workerTask(void* arg) {
+    auto                  api = static_cast<RestAPI*>(arg);
+    std::shared_ptr<Job>* job = nullptr;
+
+    for (;;) {
+        if (xQueueReceive(api->workQueue, &job, portMAX_DELAY) != pdTRUE) continue;
+        (api->*((*job)->handler))((*job)->context);
+        (*job)->done = true;
+
+        // without the wake-up the response would still be sent, on the next regular poll
+        auto wake = new std::pair<tcp_pcb*, void*>((*job)->pcb, (*job)->client);
+        if (tcpip_callback(wakeConnection, wake) != ERR_OK) delete wake;
+
+        delete job;
+    }
+}
+
 void RestAPI::handlePage(AsyncWebServerRequest* request) {
     extern const char* webPage;
     request->send(200, "text/html", webPage, [&](const String& key) -> String {
-        if (key == "FORM_ROUTE") return baseRoute + "/form";
+        if (key == "FORM_ROUTE") return formRoute;
+        if (key == "API_ROUTE") return apiRoute;
         if (key == "PAGE_TITLE") return pageTitle;
         if (key == "BUTTON_TEXT") return buttonText;
         return "";
     });
 }
 
-void RestAPI::handleFormGET(AsyncWebServerRequest* request) {
+void RestAPI::handleFormGET(Context& context) {
     JsonDocument doc;
 
     JsonObject props = doc.to<JsonObject>();
 
+    std::unique_lock<std::mutex> lock(parameterMutex, std::defer_lock);
+    if (!acquire(context, lock)) return;
+
     for (auto& parameter : parameters) {
         JsonObject element = props[parameter->key].to<JsonObject>();
-        element["type"]    = parameter->type();
-        value2json(parameter->value, element["value"].to<JsonVariant>());
+        value2json(parameter->get(), element["value"].to<JsonVariant>());
+        element["type"] = parameter->type();
         if (parameter->min.isValid()) value2json(parameter->min, element["min"].to<JsonVariant>());
         if (parameter->max.isValid()) value2json(parameter->max, element["max"].to<JsonVariant>());
         if (parameter->isString() && parameter->isPassword) element["password"] = true;
+        if (parameter->isReadOnly()) element["readonly"] = true;
     }
 
-    auto response = beginJsonResponse(request);
-    serializeJson(doc, *response);
-    request->send(response);
+    lock.unlock();
+
+    serializeJson(doc, context.output);
 }
 
-static void setErrorKeyNotFound(JsonDocument& responseDoc, AsyncResponseStream* response, const String& key) {
-    response->setCode(404);
+static void setErrorKeyNotFound(JsonDocument& responseDoc, RestAPI::Context& context, const String& key) {
+    context.code         = 404;
     responseDoc["error"] = "'" + key + "' not found";
 }
 
-void RestAPI::handleRestGET(AsyncWebServerRequest* req) {
-    auto pathElements = splitPath(apiRoute, req);
-    auto response     = beginJsonResponse(req);
+static void setErrorReadOnly(JsonDocument& responseDoc, RestAPI::Context& context, const String& key) {
+    context.code         = 403;
+    responseDoc["error"] = "'" + key + "' is read-only";
+}
+
+static void setErrorInvalid(JsonDocument& responseDoc, RestAPI::Context& context, const String& error) {
+    context.code         = 400;
+    responseDoc["error"] = error;
+}
+
+void RestAPI::handleRestGET(Context& context) {
+    auto pathElements = splitPath(apiRoute, context.url);
 
     JsonDocument responseDoc;
 
+    std::unique_lock<std::mutex> lock(parameterMutex, std::defer_lock);
+    if (!acquire(context, lock)) return;
+
     if (pathElements.size()) {
         const String& key = pathElements[0];
 
         auto parameter = findParameter(parameters, key);
 
         if (parameter)
-            value2doc("value", responseDoc, parameter->value);
+            value2doc("value", responseDoc, parameter->get());
         else
-            setErrorKeyNotFound(responseDoc, response, key);
+            setErrorKeyNotFound(responseDoc, context, key);
     } else {
         for (auto parameter : parameters) {
             const String& key = parameter->key;
-            value2doc(key, responseDoc, parameter->value);
+            value2doc(key, responseDoc, parameter->get());
         }
     }
 
-    serializeJson(responseDoc, *response);
-    req->send(response);
+    lock.unlock();
+
+    serializeJson(responseDoc, context.output);
 }
 
-void RestAPI::handleFormPOST(AsyncWebServerRequest* req, uint8_t* data, size_t size, size_t offset, size_t total) {
+void RestAPI::handleFormPOST(Context& context) {
     JsonDocument requestDoc;
-    auto         jsonError = deserializeJson(requestDoc, data, size);
+    auto         jsonError = deserializeBody(context, requestDoc);
 
     JsonDocument responseDoc;
-    auto         response = beginJsonResponse(req);
 
     if (jsonError) {
-        responseDoc["error"] = jsonError.c_str();
-        serializeJson(responseDoc, *response);
-        req->send(response);
+        setErrorInvalid(responseDoc, context, jsonError.c_str());
+        serializeJson(responseDoc, context.output);
         return;
     }
 
+    std::vector<RestParameter*>  changed;
+    std::unique_lock<std::mutex> changeLock(changeMutex, std::defer_lock);
+    std::unique_lock<std::mutex> lock(parameterMutex, std::defer_lock);
+    if (!acquire(context, changeLock) || !acquire(context, lock)) return;
+
     for (auto jsonPair : requestDoc.as<JsonObject>()) {
-        auto key       = jsonPair.key().c_str();
-        auto parameter = findParameter(parameters, key);
+        auto     key       = jsonPair.key().c_str();
+        uint16_t index     = 0;
+        auto     parameter = findParameter(parameters, key, &index);
         if (parameter) {
-            doc2value(key, requestDoc, parameter->value);
+            String error;
+            if (updateParameter(context, index, jsonPair.value(), AuditLog::Source::Form, error)) changed.push_back(parameter);
+            if (error.length()) setErrorInvalid(responseDoc, context, error);
             value2doc(key, responseDoc, parameter->value);
         }
-        if (parameterChangeHandler) parameterChangeHandler(*parameter);
     }
 
-    serializeJson(responseDoc, *response);
-    req->send(response);    
+    lock.unlock();
+
+    serializeJson(responseDoc, context.output);
+    if (parameterChangeHandler)
+        for (auto parameter : changed) parameterChangeHandler(*parameter);
 }
 
-void RestAPI::handleRestPATCH(AsyncWebServerRequest* req, uint8_t* data, size_t size, size_t offset, size_t total) {
-    auto pathElements = splitPath(apiRoute, req);
+void RestAPI::handleRestPATCH(Context& context) {
+    auto pathElements = splitPath(apiRoute, context.url);
 
     JsonDocument requestDoc;
-    auto         jsonError = deserializeJson(requestDoc, data, size);
+    auto         jsonError = deserializeBody(context, requestDoc);
 
     JsonDocument responseDoc;
-    auto         response = beginJsonResponse(req);
 
     if (jsonError) {
-        responseDoc["error"] = jsonError.c_str();
-        serializeJson(responseDoc, *response);
-        req->send(response);
+        setErrorInvalid(responseDoc, context, jsonError.c_str());
+        serializeJson(responseDoc, context.output);
         return;
     }
 
+    std::vector<RestParameter*>  changed;
+    std::unique_lock<std::mutex> changeLock(changeMutex, std::defer_lock);
+    std::unique_lock<std::mutex> lock(parameterMutex, std::defer_lock);
+    if (!acquire(context, changeLock) || !acquire(context, lock)) return;
+
     if (pathElements.size()) {
         Serial.println("im /user/api/element zweig");
         const String& key = pathElements[0];
 
-        auto parameter = findParameter(parameters, key);
-
-        if (parameter) {
-            doc2value("value", requestDoc, parameter->value);
+        uint16_t index     = 0;
+        auto     parameter = findParameter(parameters, key, &index);
+
+        if (!parameter)
+            setErrorKeyNotFound(responseDoc, context, key);
+        else if (parameter->isReadOnly())
+            setErrorReadOnly(responseDoc, context, key);
+        else {
+            String error;
+            if (updateParameter(context, index, requestDoc["value"], AuditLog::Source::Patch, error)) changed.push_back(parameter);
+            if (error.length()) setErrorInvalid(responseDoc, context, error);
             value2doc("value", responseDoc, parameter->value);
-            if (parameterChangeHandler) parameterChangeHandler(*parameter);
-        } else
-            setErrorKeyNotFound(responseDoc, response, key);
+        }
     } else {
         for (auto jsonPair : requestDoc.as<JsonObject>()) {
-            auto key       = jsonPair.key().c_str();
-            auto parameter = findParameter(parameters, key);
+            auto     key       = jsonPair.key().c_str();
+            uint16_t index     = 0;
+            auto     parameter = findParameter(parameters, key, &index);
             if (parameter) {
-                doc2value(key, requestDoc, parameter->value);
+                String error;
+                if (updateParameter(context, index, jsonPair.value(), AuditLog::Source::Patch, error)) changed.push_back(parameter);
+                if (error.length()) setErrorInvalid(responseDoc, context, error);
                 value2doc(key, responseDoc, parameter->value);
             }
-            if (parameterChangeHandler) parameterChangeHandler(*parameter);
         }
     }
 
-    serializeJson(responseDoc, *response);
-    req->send(response);
+    lock.unlock();
+
+    serializeJson(responseDoc, context.output);
+    if (parameterChangeHandler)
+        for (auto parameter : changed) parameterChangeHandler(*parameter);
 }
 
-void RestAPI::handleRestDELETE(AsyncWebServerRequest* req) {
-    auto pathElements = splitPath(apiRoute, req);
+void RestAPI::handleRestDELETE(Context& context) {
+    auto pathElements = splitPath(apiRoute, context.url);
 
     JsonDocument responseDoc;
-    auto         response = beginJsonResponse(req);
+
+    std::vector<RestParameter*>  changed;
+    std::unique_lock<std::mutex> changeLock(changeMutex, std::defer_lock);
+    std::unique_lock<std::mutex> lock(parameterMutex, std::defer_lock);
+    if (!acquire(context, changeLock) || !acquire(context, lock)) return;
 
     if (pathElements.size()) {
         const String& key       = pathElements[0];
-        auto          parameter = findParameter(parameters, key);
+        uint16_t      index     = 0;
+        auto          parameter = findParameter(parameters, key, &index);
 
-        if (parameter) {
-            parameter->value.clear();
-            value2doc(key, responseDoc, parameter->value);
-            if (parameterChangeHandler) parameterChangeHandler(*parameter);
+        if (!parameter) {
+            setErrorKeyNotFound(responseDoc, context, key);
+        } else if (parameter->isReadOnly()) {
+            setErrorReadOnly(responseDoc, context, key);
         } else {
-            setErrorKeyNotFound(responseDoc, response, key);
+            if (clearParameter(context, index)) changed.push_back(parameter);
+            value2doc(key, responseDoc, parameter->value);
         }
     } else {
-        for (auto parameter : parameters) {
-            parameter->value.clear();
+        for (uint16_t index = 0; index < parameters.size(); index++) {
+            auto parameter = parameters[index];
+            if (clearParameter(context, index)) changed.push_back(parameter);
             value2doc(parameter->key, responseDoc, parameter->value);
-            if (parameterChangeHandler) parameterChangeHandler(*parameter);
         }
     }
 
+    lock.unlock();
+
+    serializeJson(responseDoc, context.output);
+    if (parameterChangeHandler)
+        for (auto parameter : changed) parameterChangeHandler(*parameter);
+}
+
+void RestAPI::handleMetricsGET(AsyncWebServerRequest* req) {
+    JsonDocument responseDoc;
+    auto         response = beginJsonResponse(req);
+
+    responseDoc["uptime"]     = millis();
+    responseDoc["parameters"] = parameters.size();
+
+    JsonObject heap  = responseDoc["heap"].to<JsonObject>();
+    heap["free"]     = ESP.getFreeHeap();
+    heap["minFree"]  = ESP.getMinFreeHeap();
+    heap["maxAlloc"] = ESP.getMaxAllocHeap();
+
+    if (workersRunning) {
+        JsonObject workers  = responseDoc["workers"].to<JsonObject>();
+        workers["queued"]   = uxQueueMessagesWaiting(workQueue);
+        workers["rejected"] = rejectedJobs;
+    }
+
     serializeJson(responseDoc, *response);
     req->send(response);
 }
 
+// Streams {"schema": "<hash>", "parameters": {"<key>": {"type": ..., "value": ...}, ...}} as a chunked response,
+// only the JSON of one parameter is held in memory at a time. Password values are redacted and min/max are only
+// included with ?limits. The filler runs on the AsyncTCP task and retries later instead of waiting for the lock.
+// The lock is only held per chunk: an export that saw a change while streaming ends with "consistent": false,
+// one that would exceed RESTAPI_MAX_BODY_SIZE (what an import accepts) stops early and ends with "truncated": true.
+// handleImportPOST rejects both.
+void RestAPI::handleExportGET(AsyncWebServerRequest* req) {
+    auto cursor        = std::make_shared<ExportCursor>();
+    cursor->withLimits = req->hasParam("limits");
+
+    auto response = req->beginChunkedResponse("application/json", [this, cursor](uint8_t* buffer, size_t maxLen, size_t) -> size_t {
+        if (cursor->offset >= cursor->chunk.length()) {
+            std::unique_lock<std::mutex> lock(parameterMutex, std::try_to_lock);
+            if (!lock) return RESPONSE_TRY_AGAIN;
+            if (!nextExportChunk(*cursor)) return 0;
+        }
+
+        size_t length = std::min(maxLen, cursor->chunk.length() - cursor->offset);
+        memcpy(buffer, cursor->chunk.c_str() + cursor->offset, length);
+        cursor->offset += length;
+        return length;
+    });
+
+    response->addHeader("Content-Disposition", "attachment; filename=\"parameters.json\"");
+    req->send(response);
+}
+
+// Replaces cursor.chunk with the next part of the export, returns false once everything has been sent
+bool RestAPI::nextExportChunk(ExportCursor& cursor) {
+    cursor.offset = 0;
+
+    // room for the closing members, so a truncated export still fits into an import body
+    static const size_t tailLength = 48;
+
+    if (!cursor.started) {
+        cursor.started    = true;
+        cursor.generation = generation;
+        cursor.chunk      = "{\"schema\":\"" + schemaHash() + "\",\"parameters\":{";
+        cursor.length     = cursor.chunk.length();
+        return true;
+    }
+
+    while (cursor.index < parameters.size() && parameters[cursor.index]->isComputed()) cursor.index++;
+
+    if (cursor.index < parameters.size()) {
+        auto parameter = parameters[cursor.index];
+
+        JsonDocument keyDoc;
+        keyDoc.set(parameter->key);
+
+        JsonDocument entry;
+        entry["type"] = parameter->type();
+        if (parameter->isString() && parameter->isPassword)
+            entry["redacted"] = true;
+        else
+            value2doc("value", entry, parameter->value);
+        if (cursor.withLimits && parameter->min.isValid()) value2doc("min", entry, parameter->min);
+        if (cursor.withLimits && parameter->max.isValid()) value2doc("max", entry, parameter->max);
+
+        String key, value;
+        serializeJson(keyDoc, key);
+        serializeJson(entry, value);
+
+        size_t length = (cursor.exported ? 1 : 0) + key.length() + 1 + value.length();
+
+        if (cursor.length + length + tailLength <= RESTAPI_MAX_BODY_SIZE) {
+            cursor.chunk = cursor.exported++ ? "," : "";
+            cursor.chunk += key;
+            cursor.chunk += ":";
+            cursor.chunk += value;
+            cursor.length += length;
+            cursor.index++;
+            return true;
+        }
+    }
+
+    if (!cursor.finished) {
+        cursor.finished = true;
+        cursor.chunk    = "}";
+        if (cursor.generation != generation) cursor.chunk += ",\"consistent\":false";
+        if (cursor.index < parameters.size()) cursor.chunk += ",\"truncated\":true";
+        cursor.chunk += "}";
+        return true;
+    }
+
+    return false;
+}
+
+// Accepts the document produced by handleExportGET. All entries are validated before the first one is applied,
+// so an import either succeeds completely or leaves every parameter untouched.
+void RestAPI::handleImportPOST(Context& context) {
+    JsonDocument responseDoc;
+
+    auto sendError = [&](int code, const String& error) {
+        context.code         = code;
+        responseDoc["error"] = error;
+        serializeJson(responseDoc, context.output);
+    };
+
+    if (context.contentLength > RESTAPI_MAX_BODY_SIZE) return sendError(413, "body exceeds " + String(RESTAPI_MAX_BODY_SIZE) + " bytes");
+
+    JsonDocument requestDoc;
+    auto         jsonError = deserializeBody(context, requestDoc);
+
+    if (jsonError) return sendError(400, jsonError.c_str());
+
+    std::unique_lock<std::mutex> changeLock(changeMutex, std::defer_lock);
+    std::unique_lock<std::mutex> lock(parameterMutex, std::defer_lock);
+    if (!acquire(context, changeLock) || !acquire(context, lock)) return;
+
+    if (!requestDoc["schema"].isNull() && schemaHash() != requestDoc["schema"].as<const char*>()) return sendError(409, "schema mismatch");
+    if (requestDoc["truncated"] | false) return sendError(413, "export was truncated at " + String(RESTAPI_MAX_BODY_SIZE) + " bytes");
+    if (!(requestDoc["consistent"] | true)) return sendError(409, "export was not consistent, parameters changed while it was streamed");
+
+    JsonObject entries = requestDoc["parameters"].as<JsonObject>();
+    if (entries.isNull()) return sendError(400, "'parameters' missing");
+
+    for (auto entry : entries) {
+        const String key       = entry.key().c_str();
+        auto         parameter = findParameter(parameters, key);
+        String       error;
+
+        if (!parameter) return sendError(404, "'" + key + "' not found");
+        if (parameter->isComputed()) return sendError(400, "'" + key + "' is computed and not part of an export");
+        if (entry.value()["redacted"] | false) continue;
+        if (!validateValue(*parameter, entry.value()["value"], error)) return sendError(400, error);
+    }
+
+    std::vector<RestParameter*> changed;
+    JsonArray                   changedKeys = responseDoc["changed"].to<JsonArray>();
+
+    for (auto entry : entries) {
+        if (entry.value()["redacted"] | false) continue;
+
+        uint16_t       index     = 0;
+        auto           parameter = findParameter(parameters, entry.key().c_str(), &index);
+        ArduinoVariant value     = parameter->value;
+        json2value(entry.value()["value"], value);
+        if (commitValue(context, index, value, AuditLog::Source::Import)) {
+            changed.push_back(parameter);
+            changedKeys.add(parameter->key);
+        }
+    }
+
+    lock.unlock();
+
+    serializeJson(responseDoc, context.output);
+    if (changed.size()) notifyChanges(changed);
+}
+
+// FNV-1a over the key and type of every exportable parameter
+String RestAPI::schemaHash() const {
+    uint32_t hash = 2166136261u;
+
+    auto feed = [&](const String& text) {
+        for (size_t i = 0; i < text.length(); i++) {
+            hash ^= (uint8_t)text[i];
+            hash *= 16777619u;
+        }
+    };
+
+    for (auto parameter : parameters) {
+        if (parameter->isComputed()) continue;
+        feed(parameter->key);
+        feed(":");
+        feed(parameter->type());
+        if (parameter->isArray()) feed(String(parameter->value.size()));
+        feed(";");
+    }
+
+    char buffer[9];
+    snprintf(buffer, sizeof(buffer), "%08lx", (unsigned long)hash);
+    return buffer;
+}
+
+// Newest entries first, ?offset skips entries and ?limit (at most RESTAPI_AUDIT_SIZE) sets the page size
+void RestAPI::handleAuditGET(Context& context) {
+    size_t offset = context.hasParam("offset") ? std::max(0L, context.param("offset").toInt()) : 0;
+    size_t limit  = context.hasParam("limit") ? std::max(0L, context.param("limit").toInt()) : 20;
+    limit         = std::min(limit, (size_t)RESTAPI_AUDIT_SIZE);
+
+    JsonDocument responseDoc;
+
+    responseDoc["total"]    = auditLog.total();
+    responseDoc["capacity"] = RESTAPI_AUDIT_SIZE;
+    responseDoc["offset"]   = offset;
+
+    JsonArray entries = responseDoc["entries"].to<JsonArray>();
+
+    // the char arrays of the copied entry are duplicated into the document
+    AuditLog::Entry entry;
+    for (size_t age = offset; age < offset + limit && auditLog.at(age, entry); age++) {
+        JsonObject element  = entries.add<JsonObject>();
+        element["sequence"] = entry.sequence;
+        element["uptime"]   = entry.uptime;
+        element["time"]     = entry.time;
+        element["ip"]       = IPAddress(entry.clientIP).toString();
+        element["key"]      = entry.key;
+        element["source"]   = AuditLog::sourceName(entry.source);
+        element["old"]      = entry.oldValue;
+        element["new"]      = entry.newValue;
+    }
+
+    serializeJson(responseDoc, context.output);
+}
+
+// Returns false if the requested value equals the current one (parameters with a setter are always written), so no-op writes never reach the change handler.
+// Array writes are validated first and leave the parameter untouched with error set if they are rejected.
+bool RestAPI::updateParameter(Context& context, uint16_t index, JsonVariantConst json, AuditLog::Source source, String& error) {
+    RestParameter& parameter = *parameters[index];
+    if (parameter.isReadOnly()) return false;
+    ArduinoVariant value = parameter.get();
+    if (value.isArray() && !validateArray(parameter, json, error)) return false;
+    json2value(json, value);
+    return commitValue(context, index, value, source);
+}
+
+bool RestAPI::clearParameter(Context& context, uint16_t index) {
+    RestParameter& parameter = *parameters[index];
+    if (parameter.isReadOnly()) return false;
+    ArduinoVariant value = parameter.get();
+    value.clear();
+    return commitValue(context, index, value, AuditLog::Source::Delete);
+}
+
+// Single place where parameters change, every change is recorded in the audit log (in RAM, flash is written later)
+bool RestAPI::commitValue(Context& context, uint16_t index, const ArduinoVariant& value, AuditLog::Source source) {
+    RestParameter& parameter = *parameters[index];
+
+    char oldValue[RESTAPI_AUDIT_VALUE_SIZE];
+    char newValue[RESTAPI_AUDIT_VALUE_SIZE];
+    formatAuditValue(parameter, oldValue, sizeof(oldValue));
+    if (!parameter.set(value)) return false;
+    formatAuditValue(parameter, newValue, sizeof(newValue));
+    generation++;
+
+    auditLog.record(context.clientIP, parameter.key, source, oldValue, newValue);
+
+    return true;
+}
+
+void RestAPI::notifyChanges(std::vector<RestParameter*>& changed) {
+    if (parametersChangeHandler) {
+        parametersChangeHandler(changed);
+        return;
+    }
+    if (parameterChangeHandler)
+        for (auto parameter : changed) parameterChangeHandler(*parameter);
+}
+
 void RestAPI::setupRoutes() {
     if (!server) return;
 
-    server->on(formRoute.c_str(), HTTP_GET | HTTP_POST, std::bind(&RestAPI::handleFormGET, this, std::placeholders::_1), nullptr, std::bind(&RestAPI::handleFormPOST, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+    // must be registered before apiRoute, which also matches all of its sub paths
+    server->on(metricsRoute.c_str(), HTTP_GET, std::bind(&RestAPI::handleMetricsGET, this, std::placeholders::_1));
+    server->on(exportRoute.c_str(), HTTP_GET, std::bind(&RestAPI::handleExportGET, this, std::placeholders::_1));
+    server->on(importRoute.c_str(), HTTP_POST | HTTP_PUT, dispatch(Route::Import, &RestAPI::handleImportPOST), nullptr, BodyHandler);
+    server->on(auditRoute.c_str(), HTTP_GET, dispatch(Route::Audit, &RestAPI::handleAuditGET));
 
-    server->on(apiRoute.c_str(), HTTP_GET, std::bind(&RestAPI::handleRestGET, this, std::placeholders::_1));
-    server->on(apiRoute.c_str(), HTTP_PATCH | HTTP_POST | HTTP_PUT, NullHandler, nullptr, std::bind(&RestAPI::handleRestPATCH, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
-    server->on(apiRoute.c_str(), HTTP_DELETE, std::bind(&RestAPI::handleRestDELETE, this, std::placeholders::_1));
+    server->on(formRoute.c_str(), HTTP_GET, dispatch(Route::FormGET, &RestAPI::handleFormGET));
+    server->on(formRoute.c_str(), HTTP_POST, dispatch(Route::FormPOST, &RestAPI::handleFormPOST), nullptr, BodyHandler);
+
+    server->on(apiRoute.c_str(), HTTP_GET, dispatch(Route::RestGET, &RestAPI::handleRestGET));
+    server->on(apiRoute.c_str(), HTTP_PATCH | HTTP_POST | HTTP_PUT, dispatch(Route::RestPATCH, &RestAPI::handleRestPATCH), nullptr, BodyHandler);
+    server->on(apiRoute.c_str(), HTTP_DELETE, dispatch(Route::RestDELETE, &RestAPI::handleRestDELETE));
 
     server->on(baseRoute.c_str(), HTTP_GET, std::bind(&RestAPI::handlePage, this, std::placeholders::_1));
 }
@@ -221,12 +745,12 @@ static AsyncResponseStream* beginJsonResponse(AsyncWebServerRequest* request) {
     return request->beginResponseStream("application/json");
 };
 
-static std::vector<String> splitPath(const String& baseRoute, AsyncWebServerRequest* req, const char* delimiter) {
+static std::vector<String> splitPath(const String& baseRoute, const String& url, const char* delimiter) {
     std::vector<String> result;
 
-    if (!req->url().startsWith(baseRoute)) return result;
+    if (!url.startsWith(baseRoute)) return result;
 
-    String remainingURL = req->url().substring(baseRoute.length());
+    String remainingURL = url.substring(baseRoute.length());
 
     const char* token = strtok((char*)remainingURL.c_str(), delimiter);
     while (token != nullptr) {
@@ -238,20 +762,39 @@ static std::vector<String> splitPath(const String& baseRoute, AsyncWebServerRequ
 }
 
 template <typename... Types>
-static void doc2valueImpl(const String& key, JsonDocument& doc, ArduinoVariant& value, std::tuple<Types...>) {
+static void json2valueImpl(JsonVariantConst json, ArduinoVariant& value, std::tuple<Types...>) {
     auto assignValue = [&](auto type) {
         using T = decltype(type);
-        if (value.is<T>()) value = doc[key].as<T>();
+        if (value.is<T>()) value = json.as<T>();
     };
     (assignValue(Types{}), ...);
 }
 
-static void doc2value(const String& key, JsonDocument& doc, ArduinoVariant& value) {
-    doc2valueImpl(key, doc, value, ArduinoVariant::VariantTuple{});
+// Arrays are written as a whole ([1, 2, 3] starting at index 0) or as a range ({"offset": 8, "values": [1, 2]})
+template <typename... Types>
+static void json2arrayImpl(JsonVariantConst json, ArduinoVariant& value, std::tuple<Types...>) {
+    JsonArrayConst values = (json.is<JsonObjectConst>() ? json["values"] : json).as<JsonArrayConst>();
+    size_t         offset = json["offset"] | 0u;
+
+    auto assignArray = [&](auto type) {
+        using T = decltype(type);
+        T* data = value.data<T>();
+        if (!data) return;
+        for (JsonVariantConst element : values)
+            if (offset < value.size()) data[offset++] = element.as<T>();
+    };
+    (assignArray(Types{}), ...);
+}
+
+static void json2value(JsonVariantConst json, ArduinoVariant& value) {
+    if (value.isArray())
+        json2arrayImpl(json, value, ArduinoVariant::ArrayTuple{});
+    else
+        json2valueImpl(json, value, ArduinoVariant::VariantTuple{});
 }
 
 template <typename... Types>
-static void value2jsonImpl(ArduinoVariant& value, JsonVariant& json, std::tuple<Types...>) {
+static void value2jsonImpl(const ArduinoVariant& value, JsonVariant& json, std::tuple<Types...>) {
     auto assignValue = [&](auto type) {
         using T = decltype(type);
         if (value.is<T>()) json.set(static_cast<T>(value));
@@ -259,12 +802,27 @@ static void value2jsonImpl(ArduinoVariant& value, JsonVariant& json, std::tuple<
     (assignValue(Types{}), ...);
 }
 
-static void value2json(ArduinoVariant& value, JsonVariant&& json) {
-    value2jsonImpl(value, json, ArduinoVariant::VariantTuple{});
+template <typename... Types>
+static void array2jsonImpl(const ArduinoVariant& value, JsonVariant json, std::tuple<Types...>) {
+    auto assignArray = [&](auto type) {
+        using T       = decltype(type);
+        const T* data = value.data<T>();
+        if (!data) return;
+        JsonArray elements = json.to<JsonArray>();
+        for (size_t i = 0; i < value.size(); i++) elements.add(data[i]);
+    };
+    (assignArray(Types{}), ...);
+}
+
+static void value2json(const ArduinoVariant& value, JsonVariant&& json) {
+    if (value.isArray())
+        array2jsonImpl(value, json, ArduinoVariant::ArrayTuple{});
+    else
+        value2jsonImpl(value, json, ArduinoVariant::VariantTuple{});
 }
 
 template <typename... Types>
-static void value2docImpl(const String& key, JsonDocument& doc, ArduinoVariant& value, std::tuple<Types...>) {
+static void value2docImpl(const String& key, JsonDocument& doc, const ArduinoVariant& value, std::tuple<Types...>) {
     auto assignValue = [&](auto type) {
         using T = decltype(type);
         if (value.is<T>()) doc[key] = value.as<T>();
@@ -272,16 +830,121 @@ static void value2docImpl(const String& key, JsonDocument& doc, ArduinoVariant&
     (assignValue(Types{}), ...);
 }
 
-static void value2doc(const String& key, JsonDocument& doc, ArduinoVariant& value) {
-    value2docImpl(key, doc, value, ArduinoVariant::VariantTuple{});
+static void value2doc(const String& key, JsonDocument& doc, const ArduinoVariant& value) {
+    if (value.isArray())
+        array2jsonImpl(value, doc[key].to<JsonVariant>(), ArduinoVariant::ArrayTuple{});
+    else
+        value2docImpl(key, doc, value, ArduinoVariant::VariantTuple{});
+}
+
+// Copies the chunks of a request body into req->_tempObject, which is freed by the request or the Context taking it over.
+// The route handler runs once the body is complete; bodies larger than RESTAPI_MAX_BODY_SIZE are dropped.
+static void BodyHandler(AsyncWebServerRequest* req, uint8_t* data, size_t len, size_t offset, size_t total) {
+    if (total > RESTAPI_MAX_BODY_SIZE) return;
+    if (offset == 0) req->_tempObject = malloc(total);
+    if (!req->_tempObject) return;
+
+    memcpy((uint8_t*)req->_tempObject + offset, data, len);
 }
 
-static void NullHandler(AsyncWebServerRequest* req) {}
+static DeserializationError deserializeBody(const RestAPI::Context& context, JsonDocument& doc) {
+    if (context.contentLength > RESTAPI_MAX_BODY_SIZE) return DeserializationError::NoMemory;
+    if (!context.body) return DeserializationError::EmptyInput;
+    return deserializeJson(doc, context.body, context.contentLength);
+}
 
-static RestParameter* findParameter(std::vector<RestParameter*>& parameters, const String& name) {
-    for (auto parameter : parameters)
-        if (parameter->key.equalsIgnoreCase(name)) return parameter;
+static RestParameter* findParameter(std::vector<RestParameter*>& parameters, const String& name, uint16_t* index) {
+    for (size_t i = 0; i < parameters.size(); i++) {
+        if (!parameters[i]->key.equalsIgnoreCase(name)) continue;
+        if (index) *index = i;
+        return parameters[i];
+    }
     return nullptr;
 }
 
+static void formatAuditValue(const RestParameter& parameter, char* buffer, size_t size) {
+    if (parameter.isString() && parameter.isPassword)
+        strlcpy(buffer, "***", size);
+    else
+        parameter.value.toChars(buffer, size);
+}
+
+static bool validateValue(RestParameter& parameter, JsonVariantConst json, String& error) {
+    const String& key = parameter.key;
+
+    if (parameter.isArray()) return validateArray(parameter, json, error);
+
+    if ((parameter.isBool() && !json.is<bool>()) || (parameter.isNumber() && !json.is<double>()) || (parameter.isString() && !json.is<const char*>())) {
+        error = "'" + key + "' expects a " + parameter.type();
+        return false;
+    }
+
+    if (parameter.isNumber()) {
+        double number = json.as<double>();
+        if ((parameter.min.isValid() && number < parameter.min.as<double>()) || (parameter.max.isValid() && number > parameter.max.as<double>())) {
+            error = "'" + key + "' out of range";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// element.as<T>() silently wraps or truncates, so every element has to fit the element type of the array
+template <typename... Types>
+static bool fitsElement(const ArduinoVariant& value, double number, std::tuple<Types...>) {
+    bool fits = true;
+
+    auto checkType = [&](auto type) {
+        using T = decltype(type);
+        if (!value.data<T>()) return;
+        fits = number >= std::numeric_limits<T>::lowest() && number <= std::numeric_limits<T>::max();
+        if constexpr (std::is_integral_v<T>) fits = fits && number == (double)(int64_t)number;
+    };
+    (checkType(Types{}), ...);
+
+    return fits;
+}
+
+static bool validateArray(RestParameter& parameter, JsonVariantConst json, String& error) {
+    const String&  key    = parameter.key;
+    JsonArrayConst values = (json.is<JsonObjectConst>() ? json["values"] : json).as<JsonArrayConst>();
+    size_t         offset = json["offset"] | 0u;
+
+    if (values.isNull()) {
+        error = "'" + key + "' expects an array";
+        return false;
+    }
+
+    // operator| would silently fall back to 0 for a negative, fractional or string offset
+    if (!json["offset"].isNull() && !json["offset"].is<unsigned>()) {
+        error = "'" + key + "' expects a non-negative integer offset";
+        return false;
+    }
+
+    size_t size = parameter.value.size();
+    if (offset > size || values.size() > size - offset) {
+        error = "'" + key + "' has " + String(size) + " elements";
+        return false;
+    }
+
+    for (JsonVariantConst element : values) {
+        if (!element.is<double>()) {
+            error = "'" + key + "' expects numbers";
+            return false;
+        }
+        double number = element.as<double>();
+        if (!fitsElement(parameter.value, number, ArduinoVariant::ArrayTuple{})) {
+            error = "'" + key + "' element out of range";
+            return false;
+        }
+        if ((parameter.min.isValid() && number < parameter.min.as<double>()) || (parameter.max.isValid() && number > parameter.max.as<double>())) {
+            error = "'" + key + "' out of range";
+            return false;
+        }
+    }
+
+    return true;
+}
+
 #endif
\ No newline at end of file
@@ -4,16 +4,79 @@
 #error "This library requires C++17 / Espressif32 Arduino 3.x"
 #else
 
+#include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 
 #include "ArduinoVariant.h"
+#include "AuditLog.h"
 #include <Preferences.h>
 #include <RestParameter.h>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#ifndef RESTAPI_WORKER_CORE
+#if defined(CONFIG_ASYNC_TCP_RUNNING_CORE) && CONFIG_ASYNC_TCP_RUNNING_CORE >= 0
+#define RESTAPI_WORKER_CORE (1 - CONFIG_ASYNC_TCP_RUNNING_CORE)
+#else
+#define RESTAPI_WORKER_CORE 1
+#endif
+#endif
+
+#ifndef RESTAPI_WORKER_PRIORITY
+#define RESTAPI_WORKER_PRIORITY 3
+#endif
+
+#ifndef RESTAPI_WORKER_STACK_SIZE
+#define RESTAPI_WORKER_STACK_SIZE 8192
+#endif
+
+#ifndef RESTAPI_WORKER_QUEUE_LENGTH
+#define RESTAPI_WORKER_QUEUE_LENGTH 8
+#endif
+
+struct tcp_pcb;
+
 class RestAPI {
   public:
-    using Req                    = AsyncWebServerRequest*;
-    using ParameterChangeHandler = std::function<void(RestParameter& parameter)>;
+    using Req                     = AsyncWebServerRequest*;
+    using ParameterChangeHandler  = std::function<void(RestParameter& parameter)>;
+    using ParametersChangeHandler = std::function<void(std::vector<RestParameter*>& parameters)>;
+
+    // the page, _metrics and the chunked _export always run on the AsyncTCP task
+    enum class Route : uint8_t { FormGET, FormPOST, RestGET, RestPATCH, RestDELETE, Import, Audit, Count };
+    enum class ExecutionMode : uint8_t { Inline, Worker };
+
+    // Copy of everything a handler reads from the request and the response it produces. Handlers only see the
+    // context, so a worker never touches the AsyncWebServerRequest, which belongs to the AsyncTCP task.
+    struct Context {
+        String                                 url           = "";
+        uint32_t                               clientIP      = 0;
+        size_t                                 contentLength = 0;
+        char*                                  body          = nullptr;
+        std::vector<std::pair<String, String>> query;
+
+        int    code        = 200;
+        String contentType = "application/json";
+        String output      = "";
+
+        // set by dispatch() for inline handlers while workers are running, see RestAPI::acquire()
+        bool deferrable = false;
+        bool deferred   = false;
+
+        Context(AsyncWebServerRequest* request);
+        ~Context();
+        Context(const Context&)            = delete;
+        Context& operator=(const Context&) = delete;
+
+        bool   hasParam(const char* name) const;
+        String param(const char* name) const;
+    };
 
   public:
     RestAPI(AsyncWebServer& server);
@@ -25,29 +88,108 @@ class RestAPI {
     void begin(const String& baseRoute, const String& pageTitle, const String& buttonText);
 
     void onParameterChange(ParameterChangeHandler handler);
+    // called once per import with all changed parameters, falls back to onParameterChange if not set
+    void onParametersChange(ParametersChangeHandler handler);
 
-  protected:
-    AsyncWebServer* server     = nullptr;
-    String          baseRoute  = "";
-    String          formRoute  = "";
-    String          apiRoute   = "";
-    String          pageTitle  = "Configuration";
-    String          buttonText = "Send";
+    // routes in ExecutionMode::Worker are handled by a pool of tasks pinned to core instead of the AsyncTCP task,
+    // they fall back to Inline until beginWorkers() succeeded. Once workers are running the AsyncTCP task never
+    // blocks on a lock: an inline route whose lock is held by a worker is handed to the pool as well.
+    bool beginWorkers(uint8_t count = 1, int core = RESTAPI_WORKER_CORE);
+    void setExecutionMode(Route route, ExecutionMode mode);
+
+    // restores the audit log from two alternating files of pageSize bytes below path and appends every
+    // recorded change to them from a background task, call it before begin()
+    bool mirrorAuditLog(fs::FS& fs, const char* path = "/audit", size_t pageSize = 4096);
 
-    ParameterChangeHandler parameterChangeHandler = nullptr;
+  protected:
+    AsyncWebServer* server       = nullptr;
+    String          baseRoute    = "";
+    String          formRoute    = "";
+    String          apiRoute     = "";
+    String          metricsRoute = "";
+    String          exportRoute  = "";
+    String          importRoute  = "";
+    String          auditRoute   = "";
+    String          pageTitle    = "Configuration";
+    String          buttonText   = "Send";
+
+    ParameterChangeHandler  parameterChangeHandler  = nullptr;
+    ParametersChangeHandler parametersChangeHandler = nullptr;
 
     std::vector<RestParameter*> parameters;
+    // incremented by every change, a chunked export compares it to tell whether it saw a consistent state
+    uint32_t generation = 0;
+
+    AuditLog auditLog;
+
+    // guards the parameters against concurrent handlers once workers are running
+    std::mutex parameterMutex;
+    // held by writers from applying their values until the change handlers returned, taken before parameterMutex
+    std::mutex changeMutex;
+
+    ExecutionMode     executionModes[(size_t)Route::Count] = {};
+    QueueHandle_t     workQueue                            = nullptr;
+    std::atomic<bool> workersRunning                       = false;
+    uint32_t          rejectedJobs                         = 0;
 
   protected:
+    using Handler = void (RestAPI::*)(Context&);
+
+    // position of a chunked export, the chunk holds the JSON of one parameter at a time
+    struct ExportCursor {
+        size_t   index      = 0;
+        size_t   exported   = 0;
+        size_t   length     = 0;
+        uint32_t generation = 0;
+        bool     started    = false;
+        bool     finished   = false;
+        bool     withLimits = false;
+        String   chunk      = "";
+        size_t   offset     = 0;
+    };
+
+    struct Job {
+        Context           context;
+        Handler           handler;
+        std::atomic<bool> done = false;
+
+        // identify the connection to wake once the job is done, only compared in the lwIP thread
+        tcp_pcb* pcb    = nullptr;
+        void*    client = nullptr;
+
+        Job(AsyncWebServerRequest* request, Handler handler)
+            : context(request), handler(handler) {}
+    };
+
+    class JobResponse;
+
+    ArRequestHandlerFunction dispatch(Route route, Handler handler);
+    bool                     acquire(Context& context, std::unique_lock<std::mutex>& lock);
+    static void              workerTask(void* arg);
 
     void handlePage(Req request);
 
-    void handleFormGET(Req request);
-    void handleFormPOST(AsyncWebServerRequest* req, uint8_t* data, size_t size, size_t offset, size_t total);
+    void handleFormGET(Context& context);
+    void handleFormPOST(Context& context);
+
+    void handleRestGET(Context& context);
+    void handleRestPATCH(Context& context);
+    void handleRestDELETE(Context& context);
+
+    void handleMetricsGET(Req request);
+
+    void handleExportGET(Req request);
+    void handleImportPOST(Context& context);
+    bool nextExportChunk(ExportCursor& cursor);
+
+    void handleAuditGET(Context& context);
+
+    bool updateParameter(Context& context, uint16_t index, JsonVariantConst json, AuditLog::Source source, String& error);
+    bool clearParameter(Context& context, uint16_t index);
+    bool commitValue(Context& context, uint16_t index, const ArduinoVariant& value, AuditLog::Source source);
 
-    void handleRestGET(Req);
-    void handleRestPATCH(Req req, uint8_t* data, size_t len, size_t offest, size_t total);
-    void handleRestDELETE(Req);
+    String schemaHash() const;
+    void   notifyChanges(std::vector<RestParameter*>& changed);
 
     void setupRoutes();
 };
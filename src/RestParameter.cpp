@@ -1,5 +1,7 @@
 #include "RestParameter.h"
 
+#include <Arduino.h>
+
 RestParameter::RestParameter(const String& key)
     : key(key) {}
 
@@ -12,14 +14,52 @@ RestParameter::RestParameter(const String& key, const ArduinoVariant&& value, bo
 RestParameter::RestParameter(const String& key, const ArduinoVariant&& value, const MinMax&& minMax)
     : key(key), value(value), min(minMax.min), max(minMax.max) {}
 
+RestParameter::RestParameter(const String& key, Getter getter, uint32_t ttl)
+    : key(key), getter(getter), ttl(ttl) {}
+
+RestParameter::RestParameter(const String& key, Getter getter, Setter setter, uint32_t ttl)
+    : key(key), getter(getter), setter(setter), ttl(ttl) {}
+
 void RestParameter::load(Preferences& pref) {
+    if (isComputed()) return;
     value.load(key.c_str(), pref);
 }
 
 void RestParameter::save(Preferences& pref) const {
+    if (isComputed()) return;
     value.save(key.c_str(), pref);
 }
 
+void RestParameter::save(nvs_handle_t handle) const {
+    if (isComputed()) return;
+    value.save(key.c_str(), handle);
+}
+
+const ArduinoVariant& RestParameter::get() {
+    if (getter && (!cached || millis() - lastRead >= ttl)) {
+        value    = getter();
+        lastRead = millis();
+        cached   = true;
+    }
+    return value;
+}
+
+bool RestParameter::set(const ArduinoVariant& newValue) {
+    if (isReadOnly()) return false;
+    // the cached getter read may be stale, so writes through a setter always reach it
+    if (!setter && value == newValue) return false;
+    value = newValue;
+    if (setter) {
+        setter(value);
+        invalidate();
+    }
+    return true;
+}
+
+void RestParameter::invalidate() {
+    cached = false;
+}
+
 bool RestParameter::isNumber() const {
     return (value.is<int>() || value.is<float>() || value.is<double>() || value.is<int8_t>() || value.is<uint8_t>() || value.is<int16_t>() || value.is<uint16_t>() || value.is<int32_t>() || value.is<uint32_t>() || value.is<int64_t>() || value.is<uint64_t>());
 }
@@ -32,6 +72,18 @@ bool RestParameter::isBool() const {
     return value.is<bool>();
 }
 
+bool RestParameter::isArray() const {
+    return value.isArray();
+}
+
+bool RestParameter::isComputed() const {
+    return getter != nullptr;
+}
+
+bool RestParameter::isReadOnly() const {
+    return getter && !setter;
+}
+
 const String RestParameter::type() const {
     if (isBool())
         return "boolean";
@@ -39,6 +91,8 @@ const String RestParameter::type() const {
         return "number";
     else if (isString())
         return "string";
+    else if (isArray())
+        return "array";
     else
         return "unknown";
 }
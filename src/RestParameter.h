@@ -3,6 +3,8 @@
 #include <Preferences.h>
 #include <WString.h>
 
+#include <functional>
+
 #include "ArduinoVariant.h"
 
 class RestParameter {
@@ -12,6 +14,11 @@ class RestParameter {
         ArduinoVariant max = {};
     };
 
+    // computed parameters are read through the getter instead of owning a stored value,
+    // the result is cached for ttl milliseconds; without a setter they are read-only
+    using Getter = std::function<ArduinoVariant()>;
+    using Setter = std::function<void(const ArduinoVariant& value)>;
+
     static const bool Password = true;
 
   public:
@@ -19,9 +26,16 @@ class RestParameter {
     RestParameter(const String& key, const ArduinoVariant&& value);
     RestParameter(const String& key, const ArduinoVariant&& value, bool isPassword);
     RestParameter(const String& key, const ArduinoVariant&& value, const MinMax&& minMax);
+    RestParameter(const String& key, Getter getter, uint32_t ttl = 0);
+    RestParameter(const String& key, Getter getter, Setter setter, uint32_t ttl = 0);
 
     void load(Preferences& pref);
     void save(Preferences& pref) const;
+    void save(nvs_handle_t handle) const;
+
+    const ArduinoVariant& get();
+    bool                  set(const ArduinoVariant& newValue);
+    void                  invalidate();
 
     const String type() const;
 
@@ -30,6 +44,9 @@ class RestParameter {
     bool isNumber() const;
     bool isString() const;
     bool isBool() const;
+    bool isArray() const;
+    bool isComputed() const;
+    bool isReadOnly() const;
 
   public:
     String         key;
@@ -37,4 +54,11 @@ class RestParameter {
     ArduinoVariant min        = {};
     ArduinoVariant max        = {};
     bool           isPassword = false;
+
+  protected:
+    Getter   getter   = nullptr;
+    Setter   setter   = nullptr;
+    uint32_t ttl      = 0;
+    uint32_t lastRead = 0;
+    bool     cached   = false;
 };
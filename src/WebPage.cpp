@@ -17,6 +17,9 @@ const char* webPage = R"webPage(
         <button id="submitButton" class="w-full bg-blue-500 text-white py-2 rounded-lg hover:bg-blue-600 transition mt-4 hidden">%BUTTON_TEXT%</button>
     </div>
     <script>
+        // keys of the inputs edited since the last successful save
+        const dirtyFields = new Set();
+
         async function fetchSchema() {
             try {
                 const response = await fetch('%FORM_ROUTE%');
@@ -34,6 +37,7 @@ const char* webPage = R"webPage(
 
             const form = document.getElementById('dynamicForm');
             form.innerHTML = ''; // Clear any existing form fields
+            dirtyFields.clear();
 
             for (const [key, value] of Object.entries(schema)) {
                 const wrapper = document.createElement('div');
@@ -57,12 +61,21 @@ const char* webPage = R"webPage(
                     input.value = value.value || '';
                     if (value.min !== undefined) input.setAttribute('min', value.min);
                     if (value.max !== undefined) input.setAttribute('max', value.max);
+                } else if (value.type === 'array') {
+                    input.setAttribute('type', 'text');
+                    input.dataset.array = 'true';
+                    input.value = (value.value || []).join(', ');
                 } else if (value.type === 'boolean') {
                     input.setAttribute('type', 'checkbox');
                     input.className = 'mt-1';
                     input.checked = value.value || false;
                 }
 
+                if (value.readonly) input.disabled = true;
+
+                input.addEventListener('input', () => dirtyFields.add(key));
+                input.addEventListener('change', () => dirtyFields.add(key));
+
                 wrapper.appendChild(label);
                 wrapper.appendChild(input);
                 form.appendChild(wrapper);
@@ -72,19 +85,35 @@ const char* webPage = R"webPage(
             document.getElementById('submitButton').classList.remove('hidden');
         }
 
+        function inputValue(input) {
+            if (input.type === 'checkbox') return input.checked;
+            if (input.type === 'number') return Number(input.value);
+            if (input.dataset.array) return input.value.split(',').map(Number);
+            return input.value;
+        }
+
         async function sendData() {
+            if (dirtyFields.size === 0) return;
+
+            // only send the fields that were edited, the server skips unchanged values anyway
+            const keys = [...dirtyFields];
             const jsonData = {};
-            document.querySelectorAll('#dynamicForm input').forEach(input => {
-                jsonData[input.name] = input.type === 'checkbox' ? input.checked : input.value;
+            keys.forEach(key => {
+                jsonData[key] = inputValue(document.getElementById(key));
             });
 
-            const response = await fetch('%FORM_ROUTE%', {
-                method: 'POST',
+            const response = await fetch('%API_ROUTE%', {
+                method: 'PATCH',
                 headers: { 'Content-Type': 'application/json' },
                 body: JSON.stringify(jsonData)
             });
 
-            if (!response.ok) alert('Error sending data!');
+            if (!response.ok) {
+                alert('Error sending data!');
+                return;
+            }
+
+            keys.forEach(key => dirtyFields.delete(key));
         }
 
         document.addEventListener('DOMContentLoaded', () => {
@@ -2,6 +2,7 @@
 #include <ESPAsyncWebServer.h>
 #include <Preferences.h>
 #include <WiFi.h>
+#include <nvs.h>
 
 #include "RestAPI.h"
 #include "WebPage.h"
@@ -19,19 +20,44 @@ RestParameter parameters[] = {
     {"Range", 45, {-2.2f, 62}},
     {"Number", 32},
     {"DeviceID-1", "1111111111111111"},
-    {"DeviceID-2", "2222222222222222"}
+    {"DeviceID-2", "2222222222222222"},
+    {"Uptime", [] { return ArduinoVariant(uint32_t(millis() / 1000)); }, 1000},
+    {"Curve", ArduinoVariant::Int16Array(16), {0, 4095}}
 };
 
-auto& [username, password, range, number, deviceId1, deviceId2] = parameters;
+auto& [username, password, range, number, deviceId1, deviceId2, uptime, curve] = parameters;
 
 
+#ifdef RESTAPI_BENCH_PARAMETERS
+// synthetic parameters for tools/loadtest, enabled by the esp32dev-bench environment
+std::vector<RestParameter> benchParameters;
+
+void createBenchParameters() {
+    benchParameters.reserve(RESTAPI_BENCH_PARAMETERS);
+    for (int i = 0; i < RESTAPI_BENCH_PARAMETERS; i++) {
+        String key = "Bench-" + String(i);
+        if (i % 2)
+            benchParameters.emplace_back(key, i, RestParameter::MinMax{0, 1000});
+        else
+            benchParameters.emplace_back(key, key);
+    }
+}
+#endif
+
 void loadParameters() {
     prefs.begin("rest-api");
     for (auto& parameter : parameters) parameter.load(prefs);
+#ifdef RESTAPI_BENCH_PARAMETERS
+    createBenchParameters();
+    for (auto& parameter : benchParameters) parameter.load(prefs);
+#endif
 }
 
 void addParameters(RestAPI& api) {
     for (auto& parameter : parameters) api.addParameter(parameter);
+#ifdef RESTAPI_BENCH_PARAMETERS
+    for (auto& parameter : benchParameters) api.addParameter(parameter);
+#endif
 }
 
 void handleParameterChange(RestParameter& parameter) {
@@ -40,6 +66,17 @@ void handleParameterChange(RestParameter& parameter) {
     Serial.printf("Parameter \"%s\" changed to %s and has been saved.\r\n", parameter.key.c_str(), parameter.value.as<String>().c_str());
 }
 
+// every Preferences::put commits on its own, an import writes all values through one handle and commits once
+void handleParametersChange(std::vector<RestParameter*>& changed) {
+    nvs_handle_t handle;
+    if (nvs_open("rest-api", NVS_READWRITE, &handle) != ESP_OK) return;
+    for (auto parameter : changed) parameter->save(handle);
+    nvs_commit(handle);
+    nvs_close(handle);
+
+    Serial.printf("%u parameters imported and saved.\r\n", (unsigned)changed.size());
+}
+
 void setupWiFi() {
     Serial.print("Connecting Wifi");
     WiFi.begin(WIFI_SSID, WIFI_PASS);
@@ -56,8 +93,18 @@ void setupServer() {
     addParameters(api);
 
     api.onParameterChange(handleParameterChange);
+    api.onParametersChange(handleParametersChange);
     api.begin("/user", "User", "save");
 
+#ifdef RESTAPI_BENCH_WORKERS
+    // move the bulk handlers off the AsyncTCP task, small GETs stay inline
+    api.beginWorkers(RESTAPI_BENCH_WORKERS);
+    api.setExecutionMode(RestAPI::Route::FormGET, RestAPI::ExecutionMode::Worker);
+    api.setExecutionMode(RestAPI::Route::FormPOST, RestAPI::ExecutionMode::Worker);
+    api.setExecutionMode(RestAPI::Route::RestPATCH, RestAPI::ExecutionMode::Worker);
+    api.setExecutionMode(RestAPI::Route::Import, RestAPI::ExecutionMode::Worker);
+#endif
+
     server.begin();
 
     Serial.printf("Open your browser and navigate to: http://%s/user\r\n", WiFi.localIP().toString().c_str());
@@ -0,0 +1,499 @@
+#!/usr/bin/env python3
+"""Load generator and soak tester for the RestAPI endpoints.
+
+Drives GET/PATCH/DELETE/form workloads against a running device (real
+hardware or the Wokwi simulator, see README.md) and reports latency
+percentiles, throughput, error rates and the device heap trend taken from
+the <base>/api/_metrics route.
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import http.client
+import json
+import math
+import os
+import random
+import re
+import string
+import sys
+import threading
+import time
+import urllib.parse
+
+# Built-in scenarios. Every group runs `count` workers; a worker picks an
+# operation from `mix` (weighted) for each request. `rate` is the per worker
+# request rate in req/s, 0 runs the worker closed-loop as fast as possible.
+SCENARIOS = {
+    "smoke": {
+        "description": "1 poller, 1 writer for 30 seconds",
+        "duration": 30,
+        "groups": [
+            {"name": "poller", "count": 1, "rate": 5, "mix": {"get_all": 1, "get_one": 1}},
+            {"name": "writer", "count": 1, "rate": 1, "mix": {"patch_one": 1}},
+        ],
+    },
+    "pollers-100p": {
+        "description": "100 parameters (esp32dev-bench), 10 concurrent pollers, 1 writer",
+        "duration": 300,
+        "groups": [
+            {"name": "poller", "count": 10, "rate": 0, "mix": {"get_all": 1, "get_one": 4}},
+            {"name": "writer", "count": 1, "rate": 2, "mix": {"patch_one": 3, "patch_many": 1}, "batch": 10},
+        ],
+    },
+    "mixed": {
+        "description": "pollers, writers, web UI and deletes at moderate rates",
+        "duration": 600,
+        "groups": [
+            {"name": "poller", "count": 4, "rate": 10, "mix": {"get_all": 1, "get_one": 3}},
+            {"name": "writer", "count": 2, "rate": 2, "mix": {"patch_one": 3, "patch_many": 1}, "batch": 5},
+            {"name": "web-ui", "count": 1, "rate": 0.5, "mix": {"form_get": 1, "form_post": 1}},
+            {"name": "deleter", "count": 1, "rate": 0.1, "mix": {"delete_one": 1}},
+        ],
+    },
+    "soak": {
+        "description": "mixed workload for 8 hours, heap sampled every minute",
+        "duration": 8 * 3600,
+        "metrics_interval": 60,
+        "groups": [
+            {"name": "poller", "count": 4, "rate": 5, "mix": {"get_all": 1, "get_one": 3}},
+            {"name": "writer", "count": 1, "rate": 1, "mix": {"patch_one": 3, "patch_many": 1}, "batch": 5},
+            {"name": "web-ui", "count": 1, "rate": 0.2, "mix": {"form_get": 1, "form_post": 1}},
+            {"name": "auditor", "count": 1, "rate": 0.1, "mix": {"get_audit": 1}},
+        ],
+    },
+    "tail-under-write": {
+        "description": "small GETs measured while bulk writes of every parameter are in progress",
+        "duration": 120,
+        "groups": [
+            {"name": "small-get", "count": 4, "rate": 10, "mix": {"get_one": 1}},
+            {"name": "bulk-write", "count": 2, "rate": 0, "mix": {"patch_many": 1, "form_post": 1}, "batch": 0},
+        ],
+    },
+}
+
+
+def body_error(payload):
+    """Returns the "error" member of a JSON object response, some handlers report errors with status 200."""
+    if not payload.startswith(b"{") or b'"error"' not in payload:
+        return None
+    try:
+        body = json.loads(payload)
+    except ValueError:
+        return None
+    return body.get("error") if isinstance(body, dict) else None
+
+
+class Histogram:
+    """Log-bucketed latency histogram with ~1% resolution and constant memory."""
+
+    GROWTH = math.log(1.01)
+
+    def __init__(self):
+        self.buckets = {}
+        self.count   = 0
+        self.max     = 0
+
+    def record(self, micros):
+        micros = max(1, int(micros))
+        bucket = int(math.log(micros) / self.GROWTH)
+        self.buckets[bucket] = self.buckets.get(bucket, 0) + 1
+        self.count += 1
+        self.max = max(self.max, micros)
+
+    def merge(self, other):
+        for bucket, n in other.buckets.items():
+            self.buckets[bucket] = self.buckets.get(bucket, 0) + n
+        self.count += other.count
+        self.max = max(self.max, other.max)
+
+    def percentile(self, q):
+        if not self.count:
+            return 0
+        rank = math.ceil(q * self.count)
+        seen = 0
+        for bucket in sorted(self.buckets):
+            seen += self.buckets[bucket]
+            if seen >= rank:
+                return min(self.max, math.exp((bucket + 1) * self.GROWTH))
+        return self.max
+
+
+class Stats:
+    def __init__(self):
+        self.latency = Histogram()
+        self.ok      = 0
+        self.errors  = {}
+        self.bytes   = 0
+
+    def record(self, micros, error, size):
+        self.latency.record(micros)
+        self.bytes += size
+        if error:
+            self.errors[error] = self.errors.get(error, 0) + 1
+        else:
+            self.ok += 1
+
+    @property
+    def total(self):
+        return self.ok + sum(self.errors.values())
+
+
+class Target:
+    def __init__(self, url, timeout):
+        parsed       = urllib.parse.urlparse(url)
+        self.host    = parsed.hostname
+        self.port    = parsed.port or 80
+        self.base    = parsed.path.rstrip("/")
+        self.timeout = timeout
+
+    def request(self, method, path, body=None):
+        """Returns (status, payload). The device closes every connection, so none is reused."""
+        connection = http.client.HTTPConnection(self.host, self.port, timeout=self.timeout)
+        try:
+            headers = {"Content-Type": "application/json"} if body is not None else {}
+            data    = json.dumps(body) if body is not None else None
+            connection.request(method, self.base + path, body=data, headers=headers)
+            response = connection.getresponse()
+            return response.status, response.read()
+        finally:
+            connection.close()
+
+    def schema(self):
+        status, payload = self.request("GET", "/form")
+        if status != 200:
+            raise RuntimeError("GET %s/form returned %d" % (self.base, status))
+        return json.loads(payload)
+
+
+WRITE_OPS = {"patch_one", "patch_many", "form_post", "delete_one"}
+
+
+class Workload:
+    def __init__(self, target, schema, keys=None):
+        self.target   = target
+        self.schema   = schema
+        self.keys     = list(self.schema)
+        # computed parameters without a setter answer writes with 403
+        self.writable = [key for key, value in schema.items() if not value.get("readonly")]
+        # writes stay on the synthetic parameters of the bench build unless --keys says otherwise
+        if keys is None and any(key.startswith("Bench-") for key in self.writable):
+            keys = "^Bench-"
+        if keys is not None:
+            pattern       = re.compile(keys)
+            self.writable = [key for key in self.writable if pattern.search(key)]
+
+    def random_value(self, key):
+        entry = self.schema[key]
+        kind  = entry.get("type")
+        if kind == "boolean":
+            return random.random() < 0.5
+        if kind == "number":
+            low  = entry.get("min", 0)
+            high = entry.get("max", 1000)
+            if isinstance(entry.get("value"), int) and isinstance(low, int) and isinstance(high, int):
+                return random.randint(low, high)
+            return round(random.uniform(low, high), 3)
+        if kind == "array":
+            low  = entry.get("min", 0)
+            high = entry.get("max", 1000)
+            return [random.randint(int(low), int(high)) for _ in entry.get("value", [])]
+        return "".join(random.choice(string.ascii_letters) for _ in range(random.randint(4, 24)))
+
+    def sample_keys(self, batch):
+        if batch <= 0 or batch >= len(self.writable):
+            return self.writable
+        return random.sample(self.writable, batch)
+
+    def request(self, op, batch):
+        if op == "get_all":
+            return self.target.request("GET", "/api")
+        if op == "get_one":
+            return self.target.request("GET", "/api/" + random.choice(self.keys))
+        if op == "form_get":
+            return self.target.request("GET", "/form")
+        if op == "patch_one":
+            key = random.choice(self.writable)
+            return self.target.request("PATCH", "/api/" + key, {"value": self.random_value(key)})
+        if op == "patch_many":
+            return self.target.request("PATCH", "/api", {key: self.random_value(key) for key in self.sample_keys(batch)})
+        if op == "form_post":
+            return self.target.request("POST", "/form", {key: self.random_value(key) for key in self.writable})
+        if op == "get_audit":
+            return self.target.request("GET", "/api/_audit?offset=%d&limit=%d" % (random.randint(0, 16), random.randint(1, 32)))
+        if op == "delete_one":
+            return self.target.request("DELETE", "/api/" + random.choice(self.writable))
+        raise ValueError("unknown operation '%s'" % op)
+
+
+class Runner:
+    def __init__(self, workload, scenario, metrics_interval):
+        self.workload         = workload
+        self.scenario         = scenario
+        self.metrics_interval = metrics_interval
+        self.stats            = {}
+        self.heap             = []
+        self.lock             = threading.Lock()
+        self.stop             = threading.Event()
+
+    def stats_for(self, group, op):
+        with self.lock:
+            return self.stats.setdefault((group, op), Stats())
+
+    def worker(self, group):
+        ops     = list(group["mix"])
+        weights = [group["mix"][op] for op in ops]
+        rate    = group.get("rate", 0)
+        batch   = group.get("batch", 0)
+        started = time.monotonic()
+        sent    = 0
+
+        while not self.stop.is_set():
+            op = random.choices(ops, weights)[0]
+            if rate > 0:
+                # open loop: latency is taken from the scheduled send time so
+                # a stalled device is not hidden by coordinated omission
+                scheduled = started + sent / rate
+                delay     = scheduled - time.monotonic()
+                if delay > 0 and self.stop.wait(delay):
+                    break
+            else:
+                scheduled = time.monotonic()
+            sent += 1
+
+            error, size = None, 0
+            try:
+                status, payload = self.workload.request(op, batch)
+                size = len(payload)
+                if status >= 400:
+                    error = "HTTP %d" % status
+                elif body_error(payload):
+                    error = "error body"
+            except (OSError, http.client.HTTPException) as e:
+                error = type(e).__name__
+
+            elapsed = (time.monotonic() - scheduled) * 1e6
+            stats   = self.stats_for(group["name"], op)
+            with self.lock:
+                stats.record(elapsed, error, size)
+
+    def sample_metrics(self, started):
+        while True:
+            try:
+                status, payload = self.workload.target.request("GET", "/api/_metrics")
+                if status == 200:
+                    heap = json.loads(payload)["heap"]
+                    with self.lock:
+                        self.heap.append((time.monotonic() - started, heap["free"], heap["minFree"], heap["maxAlloc"]))
+            except (OSError, http.client.HTTPException, ValueError, KeyError):
+                pass
+            if self.stop.wait(self.metrics_interval):
+                break
+
+    def progress(self, started, report_interval):
+        last_total, last_time = 0, started
+        while not self.stop.wait(report_interval):
+            now = time.monotonic()
+            with self.lock:
+                total  = sum(s.total for s in self.stats.values())
+                errors = sum(sum(s.errors.values()) for s in self.stats.values())
+                heap   = self.heap[-1][1] if self.heap else None
+            print("[%7.0fs] %8d requests  %7.1f req/s  %6d errors  heap %s" % (
+                now - started, total, (total - last_total) / (now - last_time), errors,
+                heap if heap is not None else "n/a"), file=sys.stderr)
+            last_total, last_time = total, now
+
+    def run(self, duration, report_interval):
+        started = time.monotonic()
+        threads = [threading.Thread(target=self.sample_metrics, args=(started,), daemon=True),
+                   threading.Thread(target=self.progress, args=(started, report_interval), daemon=True)]
+        for group in self.scenario["groups"]:
+            for _ in range(group.get("count", 1)):
+                threads.append(threading.Thread(target=self.worker, args=(group,), daemon=True))
+        for thread in threads:
+            thread.start()
+        try:
+            self.stop.wait(duration)
+        except KeyboardInterrupt:
+            print("interrupted, writing report", file=sys.stderr)
+        self.stop.set()
+        for thread in threads:
+            thread.join(self.workload.target.timeout + 1)
+        return time.monotonic() - started
+
+
+def heap_slope(samples):
+    """Least squares slope of free heap in bytes per hour."""
+    if len(samples) < 2:
+        return 0.0
+    xs     = [s[0] for s in samples]
+    ys     = [s[1] for s in samples]
+    mean_x = sum(xs) / len(xs)
+    mean_y = sum(ys) / len(ys)
+    var    = sum((x - mean_x) ** 2 for x in xs)
+    if not var:
+        return 0.0
+    return sum((x - mean_x) * (y - mean_y) for x, y in zip(xs, ys)) / var * 3600
+
+
+def build_report(runner, elapsed):
+    rows  = []
+    total = Stats()
+    for (group, op), stats in sorted(runner.stats.items()):
+        rows.append({
+            "group": group,
+            "op": op,
+            "requests": stats.total,
+            "errors": dict(stats.errors),
+            "error_rate": sum(stats.errors.values()) / stats.total if stats.total else 0,
+            "throughput": stats.total / elapsed,
+            "p50_ms": stats.latency.percentile(0.50) / 1000,
+            "p99_ms": stats.latency.percentile(0.99) / 1000,
+            "p999_ms": stats.latency.percentile(0.999) / 1000,
+            "max_ms": stats.latency.max / 1000,
+        })
+        total.latency.merge(stats.latency)
+        total.ok += stats.ok
+        for error, n in stats.errors.items():
+            total.errors[error] = total.errors.get(error, 0) + n
+
+    report = {
+        "duration": elapsed,
+        "requests": total.total,
+        "throughput": total.total / elapsed if elapsed else 0,
+        "error_rate": sum(total.errors.values()) / total.total if total.total else 0,
+        "p50_ms": total.latency.percentile(0.50) / 1000,
+        "p99_ms": total.latency.percentile(0.99) / 1000,
+        "p999_ms": total.latency.percentile(0.999) / 1000,
+        "operations": rows,
+    }
+    if runner.heap:
+        report["heap"] = {
+            "samples": len(runner.heap),
+            "first": runner.heap[0][1],
+            "last": runner.heap[-1][1],
+            "min_free": min(s[2] for s in runner.heap),
+            "min_max_alloc": min(s[3] for s in runner.heap),
+            "slope_bytes_per_hour": heap_slope(runner.heap),
+        }
+    return report
+
+
+def print_report(report):
+    print("%-12s %-11s %9s %7s %9s %9s %9s %9s %9s" % (
+        "group", "op", "requests", "err%", "req/s", "p50 ms", "p99 ms", "p999 ms", "max ms"))
+    for row in report["operations"]:
+        print("%-12s %-11s %9d %7.2f %9.2f %9.1f %9.1f %9.1f %9.1f" % (
+            row["group"], row["op"], row["requests"], row["error_rate"] * 100, row["throughput"],
+            row["p50_ms"], row["p99_ms"], row["p999_ms"], row["max_ms"]))
+        for error, n in sorted(row["errors"].items()):
+            print("%24s %-20s %d" % ("", error, n))
+    print("%-24s %9d %7.2f %9.2f %9.1f %9.1f %9.1f" % (
+        "total", report["requests"], report["error_rate"] * 100, report["throughput"],
+        report["p50_ms"], report["p99_ms"], report["p999_ms"]))
+    if "heap" in report:
+        heap = report["heap"]
+        print("heap: first %d  last %d  min free %d  min max alloc %d  trend %+.0f bytes/h (%d samples)" % (
+            heap["first"], heap["last"], heap["min_free"], heap["min_max_alloc"],
+            heap["slope_bytes_per_hour"], heap["samples"]))
+    else:
+        print("heap: no samples, is the _metrics route reachable?")
+
+
+def compare_reports(paths):
+    """Prints the latency percentiles of every operation side by side, e.g. for an inline and a worker build."""
+    reports = []
+    for path in paths:
+        with open(path) as f:
+            reports.append({(row["group"], row["op"]): row for row in json.load(f)["operations"]})
+
+    print("%-12s %-11s %-24s %9s %9s %9s %7s" % ("group", "op", "report", "p50 ms", "p99 ms", "p999 ms", "err%"))
+    for key in sorted(set().union(*reports)):
+        for path, rows in zip(paths, reports):
+            row = rows.get(key)
+            if row is None:
+                print("%-12s %-11s %-24s %9s" % (key[0], key[1], os.path.basename(path), "-"))
+                continue
+            print("%-12s %-11s %-24s %9.1f %9.1f %9.1f %7.2f" % (
+                key[0], key[1], os.path.basename(path), row["p50_ms"], row["p99_ms"], row["p999_ms"], row["error_rate"] * 100))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--url", default="http://localhost:8080/user", help="base route of the RestAPI instance (default: Wokwi forward)")
+    parser.add_argument("--scenario", default="smoke", help="built-in scenario name")
+    parser.add_argument("--scenario-file", help="JSON file with a scenario definition, overrides --scenario")
+    parser.add_argument("--list", action="store_true", help="list built-in scenarios and exit")
+    parser.add_argument("--duration", type=float, help="override the scenario duration in seconds")
+    parser.add_argument("--keys", help="regular expression selecting the keys written by the scenario "
+                                       "(default: Bench-* keys if the device has them, otherwise every writable key)")
+    parser.add_argument("--scale", type=float, default=1.0, help="multiply the worker count of every group")
+    parser.add_argument("--timeout", type=float, default=10.0, help="per request timeout in seconds")
+    parser.add_argument("--metrics-interval", type=float, help="heap sampling interval in seconds")
+    parser.add_argument("--report-interval", type=float, default=10.0, help="progress output interval in seconds")
+    parser.add_argument("--json", help="write the final report as JSON to this file")
+    parser.add_argument("--heap-csv", help="write the heap samples as CSV to this file")
+    parser.add_argument("--max-error-rate", type=float, default=1.0, help="exit with status 1 above this error rate (0..1)")
+    parser.add_argument("--compare", nargs="+", metavar="REPORT", help="compare JSON reports of earlier runs and exit")
+    args = parser.parse_args()
+
+    if args.compare:
+        compare_reports(args.compare)
+        return 0
+
+    if args.list:
+        for name, scenario in SCENARIOS.items():
+            print("%-18s %s" % (name, scenario["description"]))
+        return 0
+
+    if args.scenario_file:
+        with open(args.scenario_file) as f:
+            scenario = json.load(f)
+    elif args.scenario in SCENARIOS:
+        scenario = SCENARIOS[args.scenario]
+    else:
+        parser.error("unknown scenario '%s', see --list" % args.scenario)
+
+    for group in scenario["groups"]:
+        group["count"] = max(1, round(group.get("count", 1) * args.scale))
+
+    target = Target(args.url, args.timeout)
+    schema = target.schema()
+    if not schema:
+        print("device reports no parameters", file=sys.stderr)
+        return 1
+
+    duration         = args.duration or scenario.get("duration", 60)
+    metrics_interval = args.metrics_interval or scenario.get("metrics_interval", 5)
+    print("%s: %s, %d parameters, %.0fs" % (args.scenario_file or args.scenario, scenario.get("description", ""),
+                                            len(schema), duration), file=sys.stderr)
+
+    workload = Workload(target, schema, args.keys)
+    writes   = any(op in WRITE_OPS for group in scenario["groups"] for op in group["mix"])
+    if writes and not workload.writable:
+        print("no writable keys match, see --keys", file=sys.stderr)
+        return 1
+    if writes:
+        print("writing %d keys: %s" % (len(workload.writable), ", ".join(workload.writable[:8]) +
+                                       (", ..." if len(workload.writable) > 8 else "")), file=sys.stderr)
+
+    runner  = Runner(workload, scenario, metrics_interval)
+    elapsed = runner.run(duration, args.report_interval)
+    report  = build_report(runner, elapsed)
+    print_report(report)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(report, f, indent=2)
+    if args.heap_csv:
+        with open(args.heap_csv, "w") as f:
+            f.write("seconds,free,min_free,max_alloc\n")
+            for sample in runner.heap:
+                f.write("%.1f,%d,%d,%d\n" % sample)
+
+    return 1 if report["error_rate"] > args.max_error_rate else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())